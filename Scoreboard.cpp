@@ -1,6 +1,7 @@
 #include "Scoreboard.h"
 #include "Simulator.h"
 #include "riscv.h"
+#include "Decoder.h"
 
 #include <iomanip>
 #include <sstream>
@@ -17,15 +18,7 @@ Scoreboard::~Scoreboard() {
 }
 
 FunctionUnitType Scoreboard::mapInstructionToFU(InstType type) {
-    if (isReadMem(type) || isWriteMem(type)) {
-        return FunctionUnitType::MEM;
-    }
-    
-    if (isMul(type)) {
-        return FunctionUnitType::MUL;
-    }
-    
-    return FunctionUnitType::ALU;
+    return instInfo(type).fu;
 }
 
 std::string Scoreboard::findAvailableFU(FunctionUnitType f_type) {
@@ -236,7 +229,7 @@ bool Scoreboard::execArthimetic(std::string funit, Instruction* inst, Simulator*
   if (branch == false) {
     jumpPC = current_pc + 4;
   }
-  if (isBranch(instType) || isJump(instType)) {
+  if (isControl(instType)) {
     simu->pc = jumpPC;
     dbgprintf("This inst JUMPs to 0x%x, offset 0x%x\n", jumpPC, inst->op.offset);
   }
@@ -401,446 +394,20 @@ bool Scoreboard::exec(std::string funit, Instruction* inst, Simulator* simu) {
 }
 
 bool Scoreboard::decode(uint32_t inst, uint64_t* reg, Instruction* score_inst, Simulator* simu) {
-  std::string instname = "";
-  // std::string &inststr = op->inststr;
-  std::string inststr = "";
-  std::string deststr, op1str, op2str, offsetstr;
-  InstType instType = InstType::UNKNOWN;
-  // op constains register value
-  int64_t op1 = 0, op2 = 0, offset = 0; // op1, op2 and offset are values
-  // destReg reg1 and rs1 contain register index
-  RegId destReg = 0, reg1 = 0, reg2 = 0; // reg1 and reg2 are operands
-
-  
-    uint32_t opcode = inst & 0x7F;
-    uint32_t funct3 = (inst >> 12) & 0x7;
-    uint32_t funct7 = (inst >> 25) & 0x7F;
-    RegId rd = (inst >> 7) & 0x1F;
-    RegId rs1 = (inst >> 15) & 0x1F;
-    RegId rs2 = (inst >> 20) & 0x1F;
-    int32_t imm_i = int32_t(inst) >> 20;
-    int32_t imm_s =
-        int32_t(((inst >> 7) & 0x1F) | ((inst >> 20) & 0xFE0)) << 20 >> 20;
-    int32_t imm_sb = int32_t(((inst >> 7) & 0x1E) | ((inst >> 20) & 0x7E0) |
-                             ((inst << 4) & 0x800) | ((inst >> 19) & 0x1000))
-                         << 19 >>
-                     19;
-    int32_t imm_u = int32_t(inst) >> 12;
-    int32_t imm_uj = int32_t(((inst >> 21) & 0x3FF) | ((inst >> 10) & 0x400) |
-                             ((inst >> 1) & 0x7F800) | ((inst >> 12) & 0x80000))
-                         << 12 >>
-                     11;
-
-    switch (opcode) {
-    case OP_REG:
-      op1 = reg[rs1];
-      op2 = reg[rs2];
-      reg1 = rs1;
-      reg2 = rs2;
-      destReg = rd;
-      switch (funct3) {
-      case 0x0: // add, mul, sub
-        if (funct7 == 0x00) {
-          instname = "add";
-          instType = ADD;
-        } else if (funct7 == 0x01) {
-          instname = "mul";
-          instType = MUL;
-        } else if (funct7 == 0x20) {
-          instname = "sub";
-          instType = SUB;
-        } else {
-          simu->panic("Unknown funct7 0x%x for funct3 0x%x\n", funct7, funct3);
-        }
-        break;
-      case 0x1: // sll, mulh
-        if (funct7 == 0x00) {
-          instname = "sll";
-          instType = SLL;
-        } else if (funct7 == 0x01) {
-          instname = "mulh";
-          instType = MULH;
-        } else {
-          simu->panic("Unknown funct7 0x%x for funct3 0x%x\n", funct7, funct3);
-        }
-        break;
-      case 0x2: // slt
-        if (funct7 == 0x00) {
-          instname = "slt";
-          instType = SLT;
-        } else {
-          simu->panic("Unknown funct7 0x%x for funct3 0x%x\n", funct7, funct3);
-        }
-        break;
-      case 0x3: // sltu
-        if (funct7 == 0x00)
-        {
-          instname = "sltu";
-          instType = SLTU;
-        }
-        else
-        {
-          simu->panic("Unknown funct7 0x%x for funct3 0x%x\n", funct7, funct3);
-        }
-        break;
-      case 0x4: // xor div
-        if (funct7 == 0x00) {
-          instname = "xor";
-          instType = XOR;
-        } else if (funct7 == 0x01) {
-          instname = "div";
-          instType = DIV;
-        } else {
-          simu->panic("Unknown funct7 0x%x for funct3 0x%x\n", funct7, funct3);
-        }
-        break;
-      case 0x5: // srl, sra
-        if (funct7 == 0x00) {
-          instname = "srl";
-          instType = SRL;
-        } else if (funct7 == 0x20) {
-          instname = "sra";
-          instType = SRA;
-        } else {
-          simu->panic("Unknown funct7 0x%x for funct3 0x%x\n", funct7, funct3);
-        }
-        break;
-      case 0x6: // or
-        if (funct7 == 0x00) {
-          instname = "or";
-          instType = OR;
-        } else {
-          simu->panic("Unknown funct7 0x%x for funct3 0x%x\n", funct7, funct3);
-        }
-        break;
-      case 0x7: // and
-        if (funct7 == 0x00) {
-          instname = "and";
-          instType = AND;
-        } else {
-          simu->panic("Unknown funct7 0x%x for funct3 0x%x\n", funct7, funct3);
-        }
-        break;
-      default:
-        simu->panic("Unknown Funct3 field %x\n", funct3);
-      }
-      op1str = REGNAME[rs1];
-      op2str = REGNAME[rs2];
-      deststr = REGNAME[rd];
-      inststr = instname + " " + deststr + "," + op1str + "," + op2str;
-      break;
-    case OP_IMM:
-      op1 = reg[rs1];
-      reg1 = rs1;
-      op2 = imm_i;
-      destReg = rd;
-      switch (funct3) {
-      case 0x0:
-        instname = "addi";
-        instType = ADDI;
-        break;
-      case 0x2:
-        instname = "slti";
-        instType = SLTI;
-        break;
-      case 0x3:
-        instname = "sltiu";
-        instType = SLTIU;
-        break;
-      case 0x4:
-        instname = "xori";
-        instType = XORI;
-        break;
-      case 0x6:
-        instname = "ori";
-        instType = ORI;
-        break;
-      case 0x7:
-        instname = "andi";
-        instType = ANDI;
-        break;
-      case 0x1:
-        instname = "slli";
-        instType = SLLI;
-        op2 = op2 & 0x3F;
-        break;
-      case 0x5:
-        if (((inst >> 26) & 0x3F) == 0x0) {
-          instname = "srli";
-          instType = SRLI;
-          op2 = op2 & 0x3F;
-        } else if (((inst >> 26) & 0x3F) == 0x10) {
-          instname = "srai";
-          instType = SRAI;
-          op2 = op2 & 0x3F;
-        } else {
-          simu->panic("Unknown funct7 0x%x for OP_IMM\n", (inst >> 26) & 0x3F);
-        }
-        break;
-      default:
-        simu->panic("Unknown Funct3 field %x\n", funct3);
-      }
-      op1str = REGNAME[rs1];
-      op2str = std::to_string(op2);
-      deststr = REGNAME[destReg];
-      inststr = instname + " " + deststr + "," + op1str + "," + op2str;
-      break;
-    case OP_LUI:
-      op1 = imm_u;
-      op2 = 0;
-      offset = imm_u;
-      destReg = rd;
-      instname = "lui";
-      instType = LUI;
-      op1str = std::to_string(imm_u);
-      deststr = REGNAME[destReg];
-      inststr = instname + " " + deststr + "," + op1str;
-      break;
-    case OP_AUIPC:
-      op1 = imm_u;
-      op2 = 0;
-      offset = imm_u;
-      destReg = rd;
-      instname = "auipc";
-      instType = AUIPC;
-      op1str = std::to_string(imm_u);
-      deststr = REGNAME[destReg];
-      inststr = instname + " " + deststr + "," + op1str;
-      break;
-    case OP_JAL:
-      op1 = imm_uj;
-      op2 = 0;
-      offset = imm_uj;
-      destReg = rd;
-      instname = "jal";
-      instType = JAL;
-      op1str = std::to_string(imm_uj);
-      deststr = REGNAME[destReg];
-      inststr = instname + " " + deststr + "," + op1str;
-      break;
-    case OP_JALR:
-      op1 = reg[rs1];
-      reg1 = rs1;
-      op2 = imm_i;
-      destReg = rd;
-      instname = "jalr";
-      instType = JALR;
-      op1str = REGNAME[rs1];
-      op2str = std::to_string(op2);
-      deststr = REGNAME[destReg];
-      inststr = instname + " " + deststr + "," + op1str + "," + op2str;
-      break;
-    case OP_BRANCH:
-      op1 = reg[rs1];
-      op2 = reg[rs2];
-      reg1 = rs1;
-      reg2 = rs2;
-      offset = imm_sb;
-      switch (funct3) {
-      case 0x0:
-        instname = "beq";
-        instType = BEQ;
-        break;
-      case 0x1:
-        instname = "bne";
-        instType = BNE;
-        break;
-      case 0x4:
-        instname = "blt";
-        instType = BLT;
-        break;
-      case 0x5:
-        instname = "bge";
-        instType = BGE;
-        break;
-      case 0x6:
-        instname = "bltu";
-        instType = BLTU;
-        break;
-      case 0x7:
-        instname = "bgeu";
-        instType = BGEU;
-        break;
-      default:
-        simu->panic("Unknown funct3 0x%x at OP_BRANCH\n", funct3);
-      }
-      op1str = REGNAME[rs1];
-      op2str = REGNAME[rs2];
-      offsetstr = std::to_string(offset);
-      inststr = instname + " " + op1str + "," + op2str + "," + offsetstr;
-      break;
-    case OP_STORE:
-      op1 = reg[rs1];
-      op2 = reg[rs2];
-      reg1 = rs1;
-      reg2 = rs2;
-      offset = imm_s;
-      switch (funct3) {
-      case 0x0:
-        instname = "sb";
-        instType = SB;
-        break;
-      case 0x1:
-        instname = "sh";
-        instType = SH;
-        break;
-      case 0x2:
-        instname = "sw";
-        instType = SW;
-        break;
-      case 0x3:
-        instname = "sd";
-        instType = SD;
-        break;
-      default:
-        simu->panic("Unknown funct3 0x%x for OP_STORE\n", funct3);
-      }
-      op1str = REGNAME[rs1];
-      op2str = REGNAME[rs2];
-      offsetstr = std::to_string(offset);
-      inststr = instname + " " + op2str + "," + offsetstr + "(" + op1str + ")";
-      break;
-    case OP_LOAD:
-      op1 = reg[rs1];
-      reg1 = rs1;
-      op2 = imm_i;
-      offset = imm_i;
-      destReg = rd;
-      switch (funct3) {
-      case 0x0:
-        instname = "lb";
-        instType = LB;
-        break;
-      case 0x1:
-        instname = "lh";
-        instType = LH;
-        break;
-      case 0x2:
-        instname = "lw";
-        instType = LW;
-        break;
-      case 0x3:
-        instname = "ld";
-        instType = LD;
-        break;
-      case 0x4:
-        instname = "lbu";
-        instType = LBU;
-        break;
-      case 0x5:
-        instname = "lhu";
-        instType = LHU;
-        break;
-      case 0x6:
-        instname = "lwu";
-        instType = LWU;
-      default:
-        simu->panic("Unknown funct3 0x%x for OP_LOAD\n", funct3);
-      }
-      op1str = REGNAME[rs1];
-      op2str = std::to_string(op2);
-      deststr = REGNAME[rd];
-      inststr = instname + " " + deststr + "," + op2str + "(" + op1str + ")";
-      break;
-    case OP_SYSTEM:
-      if (funct3 == 0x0 && funct7 == 0x000) {
-        instname = "ecall";
-        op1 = reg[REG_A0];
-        op2 = reg[REG_A7];
-        reg1 = REG_A0;
-        reg2 = REG_A7;
-        destReg = REG_A0;
-        instType = ECALL;
-      } else {
-        simu->panic("Unknown OP_SYSTEM inst with funct3 0x%x and funct7 0x%x\n",
-                    funct3, funct7);
-      }
-      inststr = instname;
-      break;
-    case OP_IMM32:
-      op1 = reg[rs1];
-      reg1 = rs1;
-      op2 = imm_i;
-      destReg = rd;
-      switch (funct3) {
-      case 0x0:
-        instname = "addiw";
-        instType = ADDIW;
-        break;
-      case 0x1:
-        instname = "slliw";
-        instType = SLLIW;
-        break;
-      case 0x5:
-        if (((inst >> 25) & 0x7F) == 0x0) {
-          instname = "srliw";
-          instType = SRLIW;
-        } else if (((inst >> 25) & 0x7F) == 0x20) {
-          instname = "sraiw";
-          instType = SRAIW;
-        } else {
-          simu->panic("Unknown shift inst type 0x%x\n", ((inst >> 25) & 0x7F));
-        }
-        break;
-      default:
-        simu->panic("Unknown funct3 0x%x for OP_ADDIW\n", funct3);
-      }
-      op1str = REGNAME[rs1];
-      op2str = std::to_string(op2);
-      deststr = REGNAME[rd];
-      inststr = instname + " " + deststr + "," + op1str + "," + op2str;
-      break;
-    case OP_32: {
-      op1 = reg[rs1];
-      op2 = reg[rs2];
-      reg1 = rs1;
-      reg2 = rs2;
-      destReg = rd;
-
-      uint32_t temp = (inst >> 25) & 0x7F; // 32bit funct7 field
-      switch (funct3) {
-      case 0x0:
-        if (temp == 0x0) {
-          instname = "addw";
-          instType = ADDW;
-        } else if (temp == 0x20) {
-          instname = "subw";
-          instType = SUBW;
-        } else {
-          simu->panic("Unknown 32bit funct7 0x%x\n", temp);
-        }
-        break;
-      case 0x1:
-        if (temp == 0x0) {
-          instname = "sllw";
-          instType = SLLW;
-        } else {
-          simu->panic("Unknown 32bit funct7 0x%x\n", temp);
-        }
-        break;
-      case 0x5:
-        if (temp == 0x0) {
-          instname = "srlw";
-          instType = SRLW;
-        } else if (temp == 0x20) {
-          instname = "sraw";
-          instType = SRAW;
-        } else {
-          simu->panic("Unknown 32bit funct7 0x%x\n", temp);
-        }
-        break;
-      default:
-        simu->panic("Unknown 32bit funct3 0x%x\n", funct3);
-      }
-      op1str = REGNAME[rs1];
-      op2str = REGNAME[rs2];
-      deststr = REGNAME[rd];
-      inststr = instname + " " + deststr + "," + op1str + "," + op2str;      
-    } break;
-    default:
-      simu->panic("Unsupported opcode 0x%x!\n", opcode);
+    DecodedOp decoded;
+    if (!decodeInst(inst, &decoded)) {
+      simu->panic("Unknown instruction 0x%08x\n", inst);
     }
 
+    InstType instType = decoded.instType;
+    // op constains register value
+    int64_t op1 = readsRs1(decoded.format) ? (int64_t)reg[decoded.rs1] : decoded.imm;
+    int64_t op2 = readsRs2(decoded.format) ? (int64_t)reg[decoded.rs2]
+                  : decoded.format == I_TYPE ? decoded.imm : 0;
+    int64_t offset = decoded.imm;
+    // destReg reg1 and rs1 contain register index
+    RegId destReg = decoded.rd, reg1 = decoded.rs1, reg2 = decoded.rs2;
+
     // dispatch function unit based on instruction type
     FunctionUnitType unit = this->mapInstructionToFU(instType);
     std::string funit = this->findAvailableFU(unit);
@@ -852,7 +419,7 @@ bool Scoreboard::decode(uint32_t inst, uint64_t* reg, Instruction* score_inst, S
         score_inst->srcReg1 = reg1;
         score_inst->srcReg2 = reg2;
         score_inst->opType = instType;
-        score_inst->instStr = inststr;
+        score_inst->instStr = disassemble(inst);
 
         if (this->registerResultStatus[destReg] != "") {
             dbgprintf("rd %d is been occupied!\n", destReg);
@@ -885,7 +452,8 @@ bool Scoreboard::decode(uint32_t inst, uint64_t* reg, Instruction* score_inst, S
             case FunctionUnitType::ALU:
               score_inst->remainingExecCycles = 0;
             break;
-            case FunctionUnitType::MEM:
+            case FunctionUnitType::LOAD:
+            case FunctionUnitType::STORE:
               score_inst->remainingExecCycles = 0;
             break;
             case FunctionUnitType::MUL:
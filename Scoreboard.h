@@ -9,7 +9,6 @@
 
 // Instruction states
 enum class InstructionState { STALL, ISSUE, READ_OPERANDS, EXECUTE, WRITE_BACK, FINNISH};
-enum class FunctionUnitType { NONE, ALU, MUL, MEM};
 
 // Instruction structure
 struct Instruction {
@@ -0,0 +1,180 @@
+#include "BranchPredictor.h"
+
+BranchPredictor *BranchPredictor::create(const std::string &name) {
+  if (name == "bimodal") {
+    return new BimodalPredictor();
+  }
+  if (name == "gshare") {
+    return new GsharePredictor();
+  }
+  if (name == "tage") {
+    return new TagePredictor();
+  }
+  return nullptr;
+}
+
+// 2-bit saturating counter helpers, values 0..3, taken when >= 2
+static inline void train(uint8_t &counter, bool taken) {
+  if (taken) {
+    if (counter < 3) counter++;
+  } else {
+    if (counter > 0) counter--;
+  }
+}
+
+BimodalPredictor::BimodalPredictor(int tableBits)
+    : tableBits(tableBits), counters(1 << tableBits, 1) {}
+
+uint32_t BimodalPredictor::index(uint64_t pc) const {
+  return (pc >> 2) & ((1 << tableBits) - 1);
+}
+
+bool BimodalPredictor::lookup(uint64_t pc, const GlobalHistory & /*history*/) {
+  return this->counters[this->index(pc)] >= 2;
+}
+
+void BimodalPredictor::update(uint64_t pc, bool taken,
+                              const GlobalHistory & /*history*/) {
+  train(this->counters[this->index(pc)], taken);
+}
+
+GsharePredictor::GsharePredictor(int tableBits, int historyBits)
+    : tableBits(tableBits), historyBits(historyBits),
+      counters(1 << tableBits, 1) {}
+
+uint32_t GsharePredictor::index(uint64_t pc,
+                                const GlobalHistory &history) const {
+  uint64_t bits = history.bits[0] & ((1ULL << historyBits) - 1);
+  return ((pc >> 2) ^ bits) & ((1 << tableBits) - 1);
+}
+
+bool GsharePredictor::lookup(uint64_t pc, const GlobalHistory &history) {
+  return this->counters[this->index(pc, history)] >= 2;
+}
+
+void GsharePredictor::update(uint64_t pc, bool taken,
+                             const GlobalHistory &history) {
+  train(this->counters[this->index(pc, history)], taken);
+}
+
+TagePredictor::TagePredictor(int baseBits, int tableBits)
+    : baseBits(baseBits), tableBits(tableBits), base(1 << baseBits, 1) {
+  const int lengths[NUM_TABLES] = {5, 15, 44, 128};
+  for (int i = 0; i < NUM_TABLES; ++i) {
+    this->historyLength[i] = lengths[i];
+    this->tables[i].resize(1 << tableBits);
+  }
+}
+
+uint32_t TagePredictor::foldHistory(const GlobalHistory &history, int length,
+                                    int bits) const {
+  uint32_t folded = 0;
+  for (int i = 0; i < length; ++i) {
+    folded ^= (uint32_t)history.at(i) << (i % bits);
+  }
+  return folded & ((1 << bits) - 1);
+}
+
+bool TagePredictor::basePredict(uint64_t pc) const {
+  return this->base[(pc >> 2) & ((1 << baseBits) - 1)] >= 2;
+}
+
+void TagePredictor::find(uint64_t pc, const GlobalHistory &history,
+                         Lookup &l) const {
+  uint32_t pcBits = pc >> 2;
+  l.provider = -1;
+  l.alt = -1;
+  for (int i = 0; i < NUM_TABLES; ++i) {
+    int len = this->historyLength[i];
+    l.index[i] = (pcBits ^ (pcBits >> tableBits) ^
+                  this->foldHistory(history, len, tableBits)) &
+                 ((1 << tableBits) - 1);
+    l.tag[i] = (pcBits ^ this->foldHistory(history, len, TAG_BITS) ^
+                (this->foldHistory(history, len, TAG_BITS - 1) << 1)) &
+               ((1 << TAG_BITS) - 1);
+  }
+  for (int i = NUM_TABLES - 1; i >= 0; --i) {
+    if (this->tables[i][l.index[i]].tag == l.tag[i]) {
+      if (l.provider == -1) {
+        l.provider = i;
+      } else {
+        l.alt = i;
+        break;
+      }
+    }
+  }
+  l.altPred = l.alt >= 0 ? this->tables[l.alt][l.index[l.alt]].ctr >= 0
+                         : this->basePredict(pc);
+  l.providerPred = l.provider >= 0
+                       ? this->tables[l.provider][l.index[l.provider]].ctr >= 0
+                       : l.altPred;
+}
+
+bool TagePredictor::lookup(uint64_t pc, const GlobalHistory &history) {
+  Lookup l;
+  this->find(pc, history, l);
+  if (l.provider >= 0) {
+    const Entry &e = this->tables[l.provider][l.index[l.provider]];
+    // a freshly allocated, still weak entry is less reliable than the alt
+    if (e.useful == 0 && (e.ctr == 0 || e.ctr == -1)) {
+      return l.altPred;
+    }
+  }
+  return l.providerPred;
+}
+
+void TagePredictor::update(uint64_t pc, bool taken,
+                           const GlobalHistory &history) {
+  Lookup l;
+  this->find(pc, history, l);
+
+  if (l.provider >= 0) {
+    Entry &e = this->tables[l.provider][l.index[l.provider]];
+    if (l.providerPred != l.altPred) {
+      if (l.providerPred == taken) {
+        if (e.useful < 3) e.useful++;
+      } else {
+        if (e.useful > 0) e.useful--;
+      }
+    }
+    if (taken) {
+      if (e.ctr < 3) e.ctr++;
+    } else {
+      if (e.ctr > -4) e.ctr--;
+    }
+    if (l.alt < 0) {
+      train(this->base[(pc >> 2) & ((1 << baseBits) - 1)], taken);
+    }
+  } else {
+    train(this->base[(pc >> 2) & ((1 << baseBits) - 1)], taken);
+  }
+
+  // On a misprediction, allocate an entry in a table with longer history
+  if (l.providerPred != taken && l.provider < NUM_TABLES - 1) {
+    bool allocated = false;
+    for (int i = l.provider + 1; i < NUM_TABLES; ++i) {
+      Entry &e = this->tables[i][l.index[i]];
+      if (e.useful == 0) {
+        e.tag = l.tag[i];
+        e.ctr = taken ? 0 : -1;
+        allocated = true;
+        break;
+      }
+    }
+    if (!allocated) {
+      for (int i = l.provider + 1; i < NUM_TABLES; ++i) {
+        Entry &e = this->tables[i][l.index[i]];
+        if (e.useful > 0) e.useful--;
+      }
+    }
+  }
+
+  // Graceful aging of the useful counters
+  if (++this->updates % USEFUL_RESET_PERIOD == 0) {
+    for (int i = 0; i < NUM_TABLES; ++i) {
+      for (Entry &e : this->tables[i]) {
+        e.useful >>= 1;
+      }
+    }
+  }
+}
@@ -0,0 +1,141 @@
+/*
+ * Branch direction predictors used by Simulator::fetch
+ *
+ * predict() is called when a conditional branch is fetched and pushes the
+ * prediction onto a speculative global history. Every fetched instruction
+ * keeps the history it saw, update() trains with it when the branch
+ * commits, so every predictor only ever trains on the correct path. A
+ * squash puts the history back with restore().
+ */
+
+#ifndef BRANCH_PREDICTOR_H
+#define BRANCH_PREDICTOR_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Outcomes of the last 128 conditional branches, newest in bit 0 of bits[0],
+// enough for the longest TAGE table
+struct GlobalHistory {
+  uint64_t bits[2] = {0, 0};
+
+  void push(bool taken) {
+    this->bits[1] = (this->bits[1] << 1) | (this->bits[0] >> 63);
+    this->bits[0] = (this->bits[0] << 1) | (taken ? 1 : 0);
+  }
+  bool at(int i) const { return (this->bits[i >> 6] >> (i & 63)) & 1; }
+};
+
+class BranchPredictor {
+public:
+  virtual ~BranchPredictor() {}
+
+  // Predicts with the speculative history, then appends the prediction
+  bool predict(uint64_t pc) {
+    bool taken = this->lookup(pc, this->speculative);
+    this->speculative.push(taken);
+    return taken;
+  }
+  // history is what the speculative history was when pc was predicted
+  virtual void update(uint64_t pc, bool taken,
+                      const GlobalHistory &history) = 0;
+  virtual const char *name() const = 0;
+
+  const GlobalHistory &history() const { return this->speculative; }
+  void restore(const GlobalHistory &history) { this->speculative = history; }
+
+  // Returns nullptr for an unknown name
+  static BranchPredictor *create(const std::string &name);
+
+protected:
+  virtual bool lookup(uint64_t pc, const GlobalHistory &history) = 0;
+
+private:
+  GlobalHistory speculative;
+};
+
+// Table of 2-bit saturating counters indexed by pc
+class BimodalPredictor : public BranchPredictor {
+public:
+  explicit BimodalPredictor(int tableBits = 12);
+
+  void update(uint64_t pc, bool taken, const GlobalHistory &history) override;
+  const char *name() const override { return "bimodal"; }
+
+protected:
+  bool lookup(uint64_t pc, const GlobalHistory &history) override;
+
+private:
+  uint32_t index(uint64_t pc) const;
+
+  int tableBits;
+  std::vector<uint8_t> counters;
+};
+
+// 2-bit counters indexed by pc xor global history
+class GsharePredictor : public BranchPredictor {
+public:
+  explicit GsharePredictor(int tableBits = 12, int historyBits = 12);
+
+  void update(uint64_t pc, bool taken, const GlobalHistory &history) override;
+  const char *name() const override { return "gshare"; }
+
+protected:
+  bool lookup(uint64_t pc, const GlobalHistory &history) override;
+
+private:
+  uint32_t index(uint64_t pc, const GlobalHistory &history) const;
+
+  int tableBits;
+  int historyBits; // at most 64
+  std::vector<uint8_t> counters;
+};
+
+// Bimodal base predictor backed by tagged tables using geometrically
+// increasing global history lengths, the longest matching table provides
+// the prediction
+class TagePredictor : public BranchPredictor {
+public:
+  TagePredictor(int baseBits = 12, int tableBits = 10);
+
+  void update(uint64_t pc, bool taken, const GlobalHistory &history) override;
+  const char *name() const override { return "tage"; }
+
+protected:
+  bool lookup(uint64_t pc, const GlobalHistory &history) override;
+
+private:
+  static const int NUM_TABLES = 4;
+  static const int TAG_BITS = 9;
+  static const int USEFUL_RESET_PERIOD = 1 << 18;
+
+  struct Entry {
+    uint16_t tag = 0xFFFF; // never matches a 9 bit tag until allocated
+    int8_t ctr = 0;     // 3-bit signed counter, taken when >= 0
+    uint8_t useful = 0; // 2-bit
+  };
+
+  struct Lookup {
+    uint32_t index[NUM_TABLES];
+    uint16_t tag[NUM_TABLES];
+    int provider; // -1 when only the base predictor matched
+    int alt;      // -1 when the alternate prediction comes from the base
+    bool providerPred;
+    bool altPred;
+  };
+
+  void find(uint64_t pc, const GlobalHistory &history, Lookup &l) const;
+  uint32_t foldHistory(const GlobalHistory &history, int length,
+                       int bits) const;
+  bool basePredict(uint64_t pc) const;
+
+  int baseBits;
+  int tableBits;
+  int historyLength[NUM_TABLES];
+  std::vector<uint8_t> base;
+  std::vector<Entry> tables[NUM_TABLES];
+  uint32_t updates = 0;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#include "BranchTarget.h"
+
+BranchTargetBuffer::BranchTargetBuffer(int entries, int ways)
+    : numSets(entries / ways), ways(ways), entries(entries) {}
+
+bool BranchTargetBuffer::lookup(uint64_t pc, uint64_t *target) {
+  Entry *set = &this->entries[((pc >> 2) % this->numSets) * this->ways];
+  for (int i = 0; i < this->ways; ++i) {
+    if (set[i].valid && set[i].pc == pc) {
+      set[i].lastUse = ++this->useClock;
+      *target = set[i].target;
+      return true;
+    }
+  }
+  return false;
+}
+
+void BranchTargetBuffer::update(uint64_t pc, uint64_t target) {
+  Entry *set = &this->entries[((pc >> 2) % this->numSets) * this->ways];
+  Entry *victim = &set[0];
+  for (int i = 0; i < this->ways; ++i) {
+    if (set[i].valid && set[i].pc == pc) {
+      victim = &set[i];
+      break;
+    }
+    if (!set[i].valid) {
+      victim = &set[i];
+    } else if (victim->valid && set[i].lastUse < victim->lastUse) {
+      victim = &set[i];
+    }
+  }
+  victim->valid = true;
+  victim->pc = pc;
+  victim->target = target;
+  victim->lastUse = ++this->useClock;
+}
+
+ReturnAddressStack::ReturnAddressStack(int depth)
+    : depth(depth), stack(depth, 0) {}
+
+void ReturnAddressStack::push(uint64_t addr) {
+  this->top = (this->top + 1) % this->depth;
+  this->stack[this->top] = addr;
+  if (this->count < this->depth) {
+    this->count++;
+  }
+}
+
+bool ReturnAddressStack::pop(uint64_t *addr) {
+  if (this->count == 0) {
+    return false;
+  }
+  *addr = this->stack[this->top];
+  this->top = (this->top - 1 + this->depth) % this->depth;
+  this->count--;
+  return true;
+}
+
+ReturnAddressStack::Snapshot ReturnAddressStack::snapshot() const {
+  Snapshot s;
+  s.top = this->top;
+  s.count = this->count;
+  s.topValue = this->stack[this->top];
+  return s;
+}
+
+void ReturnAddressStack::restore(const Snapshot &s) {
+  this->top = s.top;
+  this->count = s.count;
+  this->stack[this->top] = s.topValue;
+}
@@ -0,0 +1,60 @@
+/*
+ * Jump target prediction: a set associative branch target buffer for
+ * indirect jumps and a return address stack for function returns
+ */
+
+#ifndef BRANCH_TARGET_H
+#define BRANCH_TARGET_H
+
+#include <cstdint>
+#include <vector>
+
+// Which structure supplied the target a jump was issued with
+enum class TargetSource : uint8_t { NONE, BTB, RAS };
+
+class BranchTargetBuffer {
+public:
+  BranchTargetBuffer(int entries, int ways);
+
+  bool lookup(uint64_t pc, uint64_t *target);
+  void update(uint64_t pc, uint64_t target);
+
+private:
+  struct Entry {
+    bool valid = false;
+    uint64_t pc = 0;
+    uint64_t target = 0;
+    uint32_t lastUse = 0;
+  };
+
+  int numSets;
+  int ways;
+  uint32_t useClock = 0;
+  std::vector<Entry> entries;
+};
+
+// Circular stack, overflowing calls overwrite the oldest return address
+class ReturnAddressStack {
+public:
+  // Enough state to repair the stack after a squash
+  struct Snapshot {
+    int top = 0;
+    int count = 0;
+    uint64_t topValue = 0;
+  };
+
+  explicit ReturnAddressStack(int depth);
+
+  void push(uint64_t addr);
+  bool pop(uint64_t *addr);
+  Snapshot snapshot() const;
+  void restore(const Snapshot &s);
+
+private:
+  int depth;
+  int top = 0;
+  int count = 0;
+  std::vector<uint64_t> stack;
+};
+
+#endif
@@ -0,0 +1,241 @@
+#include "Cache.h"
+
+#include <algorithm>
+#include <cstdio>
+
+Cache::Cache(const std::string &name, const CacheConfig &config,
+             Cache *lowerCache, Dram *dram, uint32_t memoryLatency)
+    : name(name), config(config), lowerCache(lowerCache), dram(dram),
+      memoryLatency(memoryLatency) {
+  this->numSets = config.size / (config.ways * config.lineSize);
+  this->offsetBits = 0;
+  while ((1u << this->offsetBits) < (uint32_t)config.lineSize) {
+    this->offsetBits++;
+  }
+  this->lines.resize(this->numSets * config.ways);
+  this->policy = ReplacementPolicy::create(config.replacement, this->numSets,
+                                           config.ways);
+  this->prefetcher = Prefetcher::create(config.prefetcher, config.lineSize,
+                                        config.prefetchDegree);
+}
+
+Cache::~Cache() {
+  delete this->policy;
+  delete this->prefetcher;
+}
+
+uint32_t Cache::lowerAccess(uint64_t addr, bool isWrite, uint64_t cycle,
+                            uint64_t pc) {
+  if (this->lowerCache != nullptr) {
+    return this->lowerCache->access(addr, isWrite, cycle, pc);
+  }
+  if (this->dram != nullptr) {
+    return this->dram->access(addr, isWrite, cycle);
+  }
+  return this->memoryLatency;
+}
+
+Cache::Line *Cache::findLine(uint64_t addr) {
+  uint64_t lineAddr = addr >> this->offsetBits;
+  Line *ways = &this->lines[(lineAddr % this->numSets) * this->config.ways];
+  uint64_t tag = lineAddr / this->numSets;
+  for (int i = 0; i < this->config.ways; ++i) {
+    if (ways[i].valid && ways[i].tag == tag) {
+      return &ways[i];
+    }
+  }
+  return nullptr;
+}
+
+int Cache::outstandingMisses(uint64_t cycle) {
+  auto done = [cycle](uint64_t ready) { return ready <= cycle; };
+  this->mshrReady.erase(
+      std::remove_if(this->mshrReady.begin(), this->mshrReady.end(), done),
+      this->mshrReady.end());
+  return this->mshrReady.size();
+}
+
+bool Cache::canAccept(uint64_t addr, uint64_t cycle) {
+  if (this->config.mshrs == 0 || this->findLine(addr) != nullptr) {
+    return true;
+  }
+  if (this->outstandingMisses(cycle) < this->config.mshrs) {
+    return true;
+  }
+  this->mshrStalls++;
+  return false;
+}
+
+Cache::Line *Cache::allocate(uint64_t addr, uint64_t start, uint64_t pc) {
+  // fill an invalid way first, otherwise the policy picks the victim
+  uint64_t lineAddr = addr >> this->offsetBits;
+  uint32_t set = lineAddr % this->numSets;
+  Line *ways = &this->lines[set * this->config.ways];
+  int way = 0;
+  while (way < this->config.ways && ways[way].valid) {
+    way++;
+  }
+  if (way == this->config.ways) {
+    way = this->policy->victim(set);
+  }
+  Line *victim = &ways[way];
+  if (victim->valid && victim->prefetched) {
+    this->unusedPrefetches++;
+  }
+  if (victim->valid && victim->dirty) {
+    // the writeback leaves through a buffer, off the critical path
+    uint64_t victimLine = victim->tag * this->numSets + set;
+    this->lowerAccess(victimLine << this->offsetBits, true, start, NO_PC);
+    this->writebacks++;
+  }
+
+  uint64_t fillStart = start + this->config.hitLatency;
+  uint32_t fill = this->config.hitLatency +
+                  this->lowerAccess(addr, false, fillStart, pc);
+  victim->valid = true;
+  victim->dirty = false;
+  victim->prefetched = false;
+  victim->tag = lineAddr / this->numSets;
+  this->policy->insert(set, way);
+  victim->readyCycle = start + fill;
+  if (this->config.mshrs == 0) {
+    this->busyUntil = start + fill;
+  } else {
+    this->mshrReady.push_back(start + fill);
+    this->mshrBusySum += this->mshrReady.size();
+  }
+  return victim;
+}
+
+uint32_t Cache::access(uint64_t addr, bool isWrite, uint64_t cycle,
+                       uint64_t pc) {
+  if (isWrite) {
+    this->writes++;
+  } else {
+    this->reads++;
+  }
+
+  // a blocking cache waits for the fill of an earlier miss
+  uint64_t start = cycle;
+  if (this->config.mshrs == 0 && this->busyUntil > cycle) {
+    start = this->busyUntil;
+  }
+
+  Line *line = this->findLine(addr);
+  uint32_t latency = start - cycle + this->config.hitLatency;
+  bool trigger = line == nullptr;
+  if (line != nullptr) {
+    uint32_t set = this->setOf(addr);
+    this->policy->touch(set, line - &this->lines[set * this->config.ways]);
+    if (isWrite) {
+      if (this->config.writeBack) {
+        line->dirty = true;
+      } else {
+        // write through, the write buffer hides the lower latency
+        this->lowerAccess(addr, true, start, pc);
+      }
+    }
+    bool inFlight = line->readyCycle > cycle + latency;
+    if (line->prefetched) {
+      line->prefetched = false;
+      this->usefulPrefetches++;
+      if (inFlight) {
+        this->latePrefetches++;
+      }
+      trigger = true;
+    } else if (inFlight) {
+      // secondary miss, done when the outstanding fill arrives
+      this->mergedMisses++;
+    }
+    if (inFlight) {
+      latency = line->readyCycle - cycle;
+    }
+  } else {
+    if (isWrite) {
+      this->writeMisses++;
+    } else {
+      this->readMisses++;
+    }
+    if (isWrite && !this->config.writeBack) {
+      // no write allocate
+      this->lowerAccess(addr, true, start, pc);
+    } else {
+      // a lower level with every MSHR busy serves the miss once one frees
+      // up, the L1s ask canAccept first and never get here
+      if (this->config.mshrs > 0 &&
+          this->outstandingMisses(cycle) >= this->config.mshrs) {
+        start = *std::min_element(this->mshrReady.begin(),
+                                  this->mshrReady.end());
+        this->outstandingMisses(start);
+      }
+      line = this->allocate(addr, start, pc);
+      line->dirty = isWrite;
+      latency = line->readyCycle - cycle;
+    }
+  }
+  this->blockedCycles += start - cycle;
+
+  if (this->prefetcher != nullptr &&
+      (pc != NO_PC || (!isWrite && !this->prefetcher->needsPc()))) {
+    this->prefetch(pc, addr, trigger, cycle);
+  }
+  return latency;
+}
+
+void Cache::prefetch(uint64_t pc, uint64_t addr, bool trigger,
+                     uint64_t cycle) {
+  this->candidates.clear();
+  this->prefetcher->observe(pc, addr, trigger, this->candidates);
+  for (uint64_t target : this->candidates) {
+    if (this->findLine(target) != nullptr) {
+      continue;
+    }
+    // prefetches never wait, they are dropped when the cache is busy
+    bool busy = this->config.mshrs == 0
+                    ? this->busyUntil > cycle
+                    : this->outstandingMisses(cycle) >= this->config.mshrs;
+    if (busy) {
+      this->prefetchesDropped++;
+      continue;
+    }
+    this->allocate(target, cycle, NO_PC)->prefetched = true;
+    this->prefetchesIssued++;
+  }
+}
+
+void Cache::printStatistics() const {
+  uint64_t accesses = this->reads + this->writes;
+  uint64_t misses = this->readMisses + this->writeMisses;
+  printf("%s: %dKB %d-way %dB lines, %s replacement, accesses: %lu, misses: %lu (%.2f%%), "
+         "read misses: %lu, writebacks: %lu, blocked cycles: %lu\n",
+         this->name.c_str(), this->config.size / 1024, this->config.ways,
+         this->config.lineSize, this->policy->name(), accesses, misses,
+         accesses > 0 ? 100.0 * misses / accesses : 0.0, this->readMisses,
+         this->writebacks, this->blockedCycles);
+  if (this->config.mshrs > 0) {
+    // write misses only take an MSHR when they allocate
+    uint64_t allocations = this->config.writeBack ? misses : this->readMisses;
+    allocations += this->prefetchesIssued;
+    printf("%s: %d MSHRs, merged misses: %lu, MSHR full stalls: %lu, "
+           "avg outstanding at miss: %.2f\n",
+           this->name.c_str(), this->config.mshrs, this->mergedMisses,
+           this->mshrStalls,
+           allocations > 0 ? (double)this->mshrBusySum / allocations : 0.0);
+  }
+  if (this->prefetcher != nullptr) {
+    // accuracy: useful / issued, coverage: misses removed / misses without
+    // prefetching, late: useful prefetches still in flight when demanded
+    uint64_t useful = this->usefulPrefetches;
+    printf("%s: %s prefetcher, issued: %lu, dropped: %lu, useful: %lu, "
+           "accuracy: %.2f%%, coverage: %.2f%%, late: %lu (%.2f%%), "
+           "evicted unused: %lu\n",
+           this->name.c_str(), this->prefetcher->name(), this->prefetchesIssued,
+           this->prefetchesDropped, useful,
+           this->prefetchesIssued > 0 ? 100.0 * useful / this->prefetchesIssued
+                                      : 0.0,
+           useful + misses > 0 ? 100.0 * useful / (useful + misses) : 0.0,
+           this->latePrefetches, useful > 0 ? 100.0 * this->latePrefetches / useful
+                                            : 0.0,
+           this->unusedPrefetches);
+  }
+}
@@ -0,0 +1,105 @@
+/*
+ * Timing model of one cache level
+ *
+ * The data always lives in MemoryManager, a cache only tracks tags to tell
+ * how many cycles an access takes. Misses go to the lower level, or to main
+ * memory with a fixed latency for the last level.
+ *
+ * Without MSHRs a miss blocks the cache until the line is filled. With them
+ * up to that many misses are outstanding at once, and accesses to a line
+ * still being filled merge into its miss instead of taking a new MSHR.
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Config.h"
+#include "Dram.h"
+#include "Prefetcher.h"
+#include "ReplacementPolicy.h"
+
+class Cache {
+public:
+  // Misses go to lowerCache, else to dram, else take memoryLatency cycles
+  Cache(const std::string &name, const CacheConfig &config, Cache *lowerCache,
+        Dram *dram, uint32_t memoryLatency);
+  ~Cache();
+
+  // False (and counted as an MSHR stall) when the access would miss with
+  // every MSHR in use, the caller retries in a later cycle
+  bool canAccept(uint64_t addr, uint64_t cycle);
+  // pc of accesses no instruction is behind
+  static const uint64_t NO_PC = ~(uint64_t)0;
+
+  // Returns the cycles from cycle until the access completes. pc is the
+  // instruction behind a demand access, upper levels pass it down with
+  // their misses. Writebacks (NO_PC writes) never train the prefetcher,
+  // prefetches from an upper level (NO_PC reads) only train the ones that
+  // do not need a pc.
+  uint32_t access(uint64_t addr, bool isWrite, uint64_t cycle, uint64_t pc);
+
+  const std::string &getName() const { return this->name; }
+  uint32_t hitLatency() const { return this->config.hitLatency; }
+  uint32_t lineSize() const { return this->config.lineSize; }
+
+  void printStatistics() const;
+
+  // statistics
+  uint64_t reads = 0;
+  uint64_t writes = 0;
+  uint64_t readMisses = 0;
+  uint64_t writeMisses = 0;
+  uint64_t mergedMisses = 0;  // secondary misses on a line being filled
+  uint64_t writebacks = 0;
+  uint64_t blockedCycles = 0; // cycles accesses waited for a busy cache
+  uint64_t mshrStalls = 0;    // accesses refused with all MSHRs busy
+  uint64_t mshrBusySum = 0;   // outstanding misses summed over misses
+  uint64_t prefetchesIssued = 0;
+  uint64_t prefetchesDropped = 0; // no free MSHR
+  uint64_t usefulPrefetches = 0;  // prefetched lines hit by a demand access
+  uint64_t latePrefetches = 0;    // useful, but the fill was still on its way
+  uint64_t unusedPrefetches = 0;  // evicted before any demand access
+
+private:
+  struct Line {
+    bool valid = false;
+    bool dirty = false;
+    bool prefetched = false; // not touched by a demand access yet
+    uint64_t tag = 0;
+    uint64_t readyCycle = 0; // fill arrives, later accesses merge until then
+  };
+
+  // Latency of fetching or writing a whole line below this level
+  uint32_t lowerAccess(uint64_t addr, bool isWrite, uint64_t cycle,
+                       uint64_t pc);
+  uint32_t setOf(uint64_t addr) const {
+    return (addr >> this->offsetBits) % this->numSets;
+  }
+  Line *findLine(uint64_t addr);
+  // Replaces a line with the one holding addr, fetched from below starting
+  // at cycle start, and takes an MSHR or blocks the cache until it arrives
+  Line *allocate(uint64_t addr, uint64_t start, uint64_t pc);
+  // Frees the MSHRs whose fill has arrived, returns the ones still busy
+  int outstandingMisses(uint64_t cycle);
+  void prefetch(uint64_t pc, uint64_t addr, bool trigger, uint64_t cycle);
+
+  std::string name;
+  CacheConfig config;
+  Cache *lowerCache;
+  Dram *dram;
+  uint32_t memoryLatency;
+  uint32_t numSets;
+  int offsetBits;
+  std::vector<Line> lines; // numSets * ways, one set after the other
+  uint64_t busyUntil = 0;          // blocking cache only
+  std::vector<uint64_t> mshrReady; // fill cycle of each busy MSHR
+  ReplacementPolicy *policy;
+  Prefetcher *prefetcher;
+  std::vector<uint64_t> candidates;
+};
+
+#endif
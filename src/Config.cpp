@@ -0,0 +1,356 @@
+#include "Config.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+static bool parseInt(const std::string &value, int *out) {
+  char *end = nullptr;
+  long v = strtol(value.c_str(), &end, 0);
+  if (value.empty() || *end != '\0' || v < 0) {
+    return false;
+  }
+  *out = (int)v;
+  return true;
+}
+
+SimConfig::SimConfig() {
+  for (int t = 0; t < FU_TYPE_COUNT; ++t) {
+    this->fuCount[t] = 1;
+    this->fuPipelined[t] = true;
+  }
+  this->fuCount[(int)FunctionUnitType::ALU] = 2;
+  this->fuPipelined[(int)FunctionUnitType::DIV] = false;
+  for (int op = 0; op < RISCV::INST_TYPE_COUNT; ++op) {
+    this->opLatency[op] = RISCV::instInfo((RISCV::InstType)op).latency + 1;
+  }
+}
+
+// "<unit>-units", "<unit>-pipelined" and "<unit>-latency" apply to one
+// FunctionUnitType, "latency-<opcode>" to a single opcode
+bool SimConfig::setUnitOption(const std::string &key, const std::string &value) {
+  for (int t = 1; t < FU_TYPE_COUNT; ++t) {
+    std::string unit = FU_NAME[t];
+    if (key == unit + "-units") {
+      return parseInt(value, &this->fuCount[t]);
+    }
+    if (key == unit + "-pipelined") {
+      int pipelined;
+      if (!parseInt(value, &pipelined) || pipelined > 1) {
+        return false;
+      }
+      this->fuPipelined[t] = pipelined;
+      return true;
+    }
+    if (key == unit + "-latency") {
+      int latency;
+      if (!parseInt(value, &latency)) {
+        return false;
+      }
+      for (int op = 0; op < RISCV::INST_TYPE_COUNT; ++op) {
+        if ((int)RISCV::instInfo((RISCV::InstType)op).fu == t) {
+          this->opLatency[op] = latency;
+        }
+      }
+      return true;
+    }
+  }
+  for (int op = 0; op < RISCV::INST_TYPE_COUNT; ++op) {
+    if (key == std::string("latency-") + RISCV::INSTNAME[op]) {
+      return parseInt(value, &this->opLatency[op]);
+    }
+  }
+  return false;
+}
+
+// "<cache>-size", "-ways", "-line", "-latency", "-write", "-mshrs",
+// "-prefetch", "-prefetch-degree" and "-replacement" for l1i, l1d and l2
+bool SimConfig::setCacheOption(const std::string &key, const std::string &value) {
+  const char *names[] = {"l1i", "l1d", "l2"};
+  CacheConfig *caches[] = {&this->l1i, &this->l1d, &this->l2};
+  for (int i = 0; i < 3; ++i) {
+    std::string prefix = std::string(names[i]) + "-";
+    if (key.compare(0, prefix.size(), prefix) != 0) {
+      continue;
+    }
+    std::string field = key.substr(prefix.size());
+    CacheConfig *c = caches[i];
+    if (field == "size") {
+      return parseInt(value, &c->size);
+    }
+    if (field == "ways") {
+      return parseInt(value, &c->ways);
+    }
+    if (field == "line") {
+      return parseInt(value, &c->lineSize);
+    }
+    if (field == "latency") {
+      return parseInt(value, &c->hitLatency);
+    }
+    if (field == "mshrs") {
+      return parseInt(value, &c->mshrs);
+    }
+    if (field == "prefetch") {
+      c->prefetcher = value;
+      return value == "none" || value == "nextline" || value == "stride" ||
+             value == "stream";
+    }
+    if (field == "prefetch-degree") {
+      return parseInt(value, &c->prefetchDegree);
+    }
+    if (field == "replacement") {
+      c->replacement = value;
+      return value == "lru" || value == "plru" || value == "random" ||
+             value == "srrip" || value == "brrip";
+    }
+    if (field == "write") {
+      c->writeBack = value == "back";
+      return value == "back" || value == "through";
+    }
+  }
+  return false;
+}
+
+// "dram-channels", "-banks", "-row", "-page", "-trcd", "-tcas", "-trp",
+// "-tburst" and "-queue"
+bool SimConfig::setDramOption(const std::string &key, const std::string &value) {
+  DramConfig *d = &this->dram;
+  if (key == "dram-channels") {
+    return parseInt(value, &d->channels);
+  }
+  if (key == "dram-banks") {
+    return parseInt(value, &d->banks);
+  }
+  if (key == "dram-row") {
+    return parseInt(value, &d->rowBytes);
+  }
+  if (key == "dram-page") {
+    d->openPage = value == "open";
+    return value == "open" || value == "closed";
+  }
+  if (key == "dram-trcd") {
+    return parseInt(value, &d->tRCD);
+  }
+  if (key == "dram-tcas") {
+    return parseInt(value, &d->tCAS);
+  }
+  if (key == "dram-trp") {
+    return parseInt(value, &d->tRP);
+  }
+  if (key == "dram-tburst") {
+    return parseInt(value, &d->tBurst);
+  }
+  if (key == "dram-queue") {
+    return parseInt(value, &d->queueSize);
+  }
+  return false;
+}
+
+bool SimConfig::set(const std::string &option) {
+  size_t eq = option.find('=');
+  if (eq == std::string::npos) {
+    return false;
+  }
+  std::string key = option.substr(0, eq);
+  std::string value = option.substr(eq + 1);
+
+  if (key == "fetch-width") {
+    return parseInt(value, &this->fetchWidth);
+  }
+  if (key == "fetch-queue") {
+    return parseInt(value, &this->fetchQueueSize);
+  }
+  if (key == "fetch-block") {
+    return parseInt(value, &this->fetchBlockBytes);
+  }
+  if (key == "taken-bubble") {
+    return parseInt(value, &this->takenBranchBubble);
+  }
+  if (key == "issue-width") {
+    return parseInt(value, &this->issueWidth);
+  }
+  if (key == "commit-width") {
+    return parseInt(value, &this->commitWidth);
+  }
+  if (key == "store-ports") {
+    return parseInt(value, &this->storeCommitPorts);
+  }
+  if (key == "rob-size") {
+    return parseInt(value, &this->robSize);
+  }
+  if (key == "rs-size") {
+    return parseInt(value, &this->rsSize);
+  }
+  if (key == "lsq-size") {
+    return parseInt(value, &this->lsqSize);
+  }
+  if (key == "sb-size") {
+    return parseInt(value, &this->storeBufferSize);
+  }
+  if (key == "mem-dep") {
+    this->memDependence = value;
+    return value == "storeset" || value == "conservative";
+  }
+  if (key == "ssit-size") {
+    return parseInt(value, &this->ssitSize);
+  }
+  if (key == "lfst-size") {
+    return parseInt(value, &this->lfstSize);
+  }
+  if (key == "memory") {
+    this->memoryModel = value;
+    return value == "dram" || value == "fixed";
+  }
+  if (key == "mem-latency") {
+    return parseInt(value, &this->memoryLatency);
+  }
+  if (key == "stack-profile") {
+    int enabled;
+    if (!parseInt(value, &enabled) || enabled > 1) {
+      return false;
+    }
+    this->stackProfile = enabled;
+    return true;
+  }
+  if (key == "stack-profile-line") {
+    return parseInt(value, &this->stackProfileLine);
+  }
+  if (key == "stack-profile-max") {
+    return parseInt(value, &this->stackProfileMax);
+  }
+  if (key == "btb-entries") {
+    return parseInt(value, &this->btbEntries);
+  }
+  if (key == "btb-ways") {
+    return parseInt(value, &this->btbWays);
+  }
+  if (key == "ras-depth") {
+    return parseInt(value, &this->rasDepth);
+  }
+  return this->setUnitOption(key, value) || this->setCacheOption(key, value) ||
+         this->setDramOption(key, value);
+}
+
+bool SimConfig::validate() const {
+  if (this->fetchWidth <= 0 || this->fetchQueueSize <= 0) {
+    fprintf(stderr, "fetch-width and fetch-queue must be positive\n");
+    return false;
+  }
+  if (this->fetchBlockBytes < 4 ||
+      (this->fetchBlockBytes & (this->fetchBlockBytes - 1)) != 0) {
+    fprintf(stderr, "fetch-block must be a power of two of at least 4\n");
+    return false;
+  }
+  if (this->issueWidth <= 0 || this->robSize <= 0 || this->rsSize <= 0 ||
+      this->lsqSize <= 0 || this->storeBufferSize <= 0) {
+    fprintf(stderr, "issue-width, rob-size, rs-size, lsq-size and sb-size must "
+                    "be positive\n");
+    return false;
+  }
+  if (this->commitWidth <= 0 || this->storeCommitPorts <= 0) {
+    fprintf(stderr, "commit-width and store-ports must be positive\n");
+    return false;
+  }
+  for (int t = 1; t < FU_TYPE_COUNT; ++t) {
+    if (this->fuCount[t] <= 0) {
+      fprintf(stderr, "%s-units must be positive\n", FU_NAME[t]);
+      return false;
+    }
+  }
+  for (int op = 0; op < RISCV::INST_TYPE_COUNT; ++op) {
+    if (this->opLatency[op] <= 0) {
+      fprintf(stderr, "latency-%s must be positive\n", RISCV::INSTNAME[op]);
+      return false;
+    }
+  }
+  if (this->ssitSize <= 0 || this->lfstSize <= 0) {
+    fprintf(stderr, "ssit-size and lfst-size must be positive\n");
+    return false;
+  }
+  const char *names[] = {"l1i", "l1d", "l2"};
+  const CacheConfig *caches[] = {&this->l1i, &this->l1d, &this->l2};
+  for (int i = 0; i < 3; ++i) {
+    const CacheConfig *c = caches[i];
+    if (c->lineSize < 8 || (c->lineSize & (c->lineSize - 1)) != 0 ||
+        c->ways <= 0 || c->size < c->ways * c->lineSize ||
+        c->size % (c->ways * c->lineSize) != 0 || c->hitLatency <= 0) {
+      fprintf(stderr, "%s: size must be a multiple of ways * line, line a power "
+                      "of two, latency positive\n", names[i]);
+      return false;
+    }
+    if (c->replacement == "plru" && (c->ways & (c->ways - 1)) != 0) {
+      fprintf(stderr, "%s: plru replacement needs a power of two ways\n", names[i]);
+      return false;
+    }
+    if (c->prefetchDegree <= 0) {
+      fprintf(stderr, "%s-prefetch-degree must be positive\n", names[i]);
+      return false;
+    }
+  }
+  if (this->dram.channels <= 0 || this->dram.banks <= 0 ||
+      this->dram.rowBytes <= 0 || this->dram.tBurst <= 0 ||
+      this->dram.queueSize <= 0) {
+    fprintf(stderr, "dram-channels, -banks, -row, -tburst and -queue must be positive\n");
+    return false;
+  }
+  if (this->stackProfileLine < 4 ||
+      (this->stackProfileLine & (this->stackProfileLine - 1)) != 0 ||
+      this->stackProfileMax < 1024 ||
+      (this->stackProfileMax & (this->stackProfileMax - 1)) != 0) {
+    fprintf(stderr, "stack-profile-line must be a power of two of at least 4, "
+                    "stack-profile-max a power of two of at least 1024\n");
+    return false;
+  }
+  if (this->btbWays <= 0 || this->btbEntries < this->btbWays ||
+      this->btbEntries % this->btbWays != 0) {
+    fprintf(stderr, "btb-entries must be a multiple of btb-ways\n");
+    return false;
+  }
+  if (this->rasDepth <= 0) {
+    fprintf(stderr, "ras-depth must be positive\n");
+    return false;
+  }
+  return true;
+}
+
+void SimConfig::printUsage() const {
+  printf("Options for -c key=value:\n");
+  printf("\tfetch-width=%d\tinstructions fetched per cycle\n", this->fetchWidth);
+  printf("\tfetch-queue=%d\tfetch queue entries\n", this->fetchQueueSize);
+  printf("\tfetch-block=%d\taligned fetch block in bytes\n", this->fetchBlockBytes);
+  printf("\ttaken-bubble=%d\tfetch cycles lost after a taken branch\n",
+         this->takenBranchBubble);
+  printf("\tissue-width=%d\tinstructions issued per cycle\n", this->issueWidth);
+  printf("\tcommit-width=%d\tinstructions retired per cycle\n", this->commitWidth);
+  printf("\tstore-ports=%d\tstores retired per cycle\n", this->storeCommitPorts);
+  printf("\trob-size=%d\treorder buffer entries\n", this->robSize);
+  printf("\trs-size=%d\treservation stations\n", this->rsSize);
+  for (int t = 1; t < FU_TYPE_COUNT; ++t) {
+    printf("\t%s-units=%d %s-pipelined=%d %s-latency=N\n", FU_NAME[t],
+           this->fuCount[t], FU_NAME[t], this->fuPipelined[t], FU_NAME[t]);
+  }
+  printf("\tlatency-<opcode>=N\texecute cycles of one opcode\n");
+  printf("\tlsq-size=%d\tload/store queue entries\n", this->lsqSize);
+  printf("\tsb-size=%d\tpost-commit store buffer entries\n", this->storeBufferSize);
+  printf("\tmem-dep=%s\tstoreset|conservative load speculation\n",
+         this->memDependence.c_str());
+  printf("\tssit-size=%d\tstore set id table entries\n", this->ssitSize);
+  printf("\tlfst-size=%d\tlast fetched store table entries\n", this->lfstSize);
+  printf("\t<l1i|l1d|l2>-size|-ways|-line|-latency|-mshrs=N, -write=back|through\n");
+  printf("\t<l1i|l1d|l2>-prefetch=none|nextline|stride|stream, -prefetch-degree=N\n");
+  printf("\t<l1i|l1d|l2>-replacement=lru|plru|random|srrip|brrip\n");
+  printf("\tmemory=%s\tdram|fixed main memory timing\n", this->memoryModel.c_str());
+  printf("\tmem-latency=%d\tfixed main memory cycles\n", this->memoryLatency);
+  printf("\tdram-channels=%d dram-banks=%d dram-row=%d dram-page=%s\n",
+         this->dram.channels, this->dram.banks, this->dram.rowBytes,
+         this->dram.openPage ? "open" : "closed");
+  printf("\tdram-trcd=%d dram-tcas=%d dram-trp=%d dram-tburst=%d dram-queue=%d\n",
+         this->dram.tRCD, this->dram.tCAS, this->dram.tRP, this->dram.tBurst,
+         this->dram.queueSize);
+  printf("\tstack-profile=%d\tprint LRU miss ratios of many cache sizes\n",
+         this->stackProfile);
+  printf("\tstack-profile-line=%d stack-profile-max=%d\tline and largest size\n",
+         this->stackProfileLine, this->stackProfileMax);
+  printf("\tbtb-entries=%d\tbranch target buffer entries\n", this->btbEntries);
+  printf("\tbtb-ways=%d\tbranch target buffer associativity\n", this->btbWays);
+  printf("\tras-depth=%d\treturn address stack entries\n", this->rasDepth);
+}
@@ -0,0 +1,95 @@
+/*
+ * Microarchitecture parameters, set from the command line with -c key=value
+ */
+
+#ifndef SIM_CONFIG_H
+#define SIM_CONFIG_H
+
+#include <string>
+
+#include "riscv.h"
+
+struct CacheConfig {
+  int size;       // bytes
+  int ways;
+  int lineSize;   // bytes
+  int hitLatency; // cycles
+  bool writeBack; // write back + write allocate, else write through without
+  int mshrs;      // outstanding misses, 0 blocks the cache on every miss
+  std::string prefetcher; // "none", "nextline", "stride" or "stream"
+  int prefetchDegree;     // lines prefetched ahead
+  std::string replacement; // "lru", "plru", "random", "srrip" or "brrip"
+};
+
+struct DramConfig {
+  int channels;
+  int banks;    // per channel
+  int rowBytes; // row buffer size
+  bool openPage; // keep the row open after an access, else precharge
+  int tRCD;     // activate to column command, cycles
+  int tCAS;     // column command to data
+  int tRP;      // precharge
+  int tBurst;   // data transfer of one line
+  int queueSize; // controller queue entries per channel
+};
+
+struct SimConfig {
+  // front end
+  int fetchWidth = 4;
+  int fetchQueueSize = 16;
+  int fetchBlockBytes = 16;  // fetch groups stay inside one aligned block
+  int takenBranchBubble = 1; // cycles lost redirecting to a predicted target
+
+  // back end
+  int issueWidth = 1;
+  int commitWidth = 1;
+  int storeCommitPorts = 1; // stores retired per cycle
+  int robSize = 5;
+  int rsSize = 9;
+  int lsqSize = 16;
+  int storeBufferSize = 8; // committed stores waiting for the L1D
+
+  // memory dependence prediction, "storeset" or "conservative"
+  std::string memDependence = "storeset";
+  int ssitSize = 1024;
+  int lfstSize = 128;
+
+  // functional units, indexed by FunctionUnitType
+  int fuCount[FU_TYPE_COUNT];
+  bool fuPipelined[FU_TYPE_COUNT];
+  int opLatency[RISCV::INST_TYPE_COUNT]; // execute cycles of each opcode
+
+  // memory hierarchy
+  CacheConfig l1i = {32 * 1024, 8, 64, 1, true, 0, "none", 2, "lru"};
+  CacheConfig l1d = {32 * 1024, 8, 64, 2, true, 8, "none", 2, "lru"};
+  CacheConfig l2 = {256 * 1024, 8, 64, 10, true, 16, "none", 2, "lru"};
+  std::string memoryModel = "dram"; // "dram" or "fixed" at mem-latency
+  int memoryLatency = 100;
+  DramConfig dram = {1, 8, 8192, true, 42, 42, 42, 8, 32};
+
+  // single pass miss ratio profile of the fetch and execMem address streams
+  bool stackProfile = false;
+  int stackProfileLine = 64;
+  int stackProfileMax = 4 * 1024 * 1024; // largest cache size reported
+
+  // jump target prediction
+  int btbEntries = 512;
+  int btbWays = 4;
+  int rasDepth = 16;
+
+  SimConfig();
+
+  // Parses one "key=value" option, returns false for an unknown key or a
+  // bad value
+  bool set(const std::string &option);
+  // Checks the parameters against each other once all options are parsed
+  bool validate() const;
+  void printUsage() const;
+
+private:
+  bool setUnitOption(const std::string &key, const std::string &value);
+  bool setCacheOption(const std::string &key, const std::string &value);
+  bool setDramOption(const std::string &key, const std::string &value);
+};
+
+#endif
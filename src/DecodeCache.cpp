@@ -0,0 +1,78 @@
+#include "DecodeCache.h"
+#include "Decoder.h"
+#include "Simulator.h"
+#include "Tomasulo.h"
+#include "riscv.h"
+
+using namespace RISCV;
+
+DecodeCache::DecodeCache() {}
+
+DecodeCache::~DecodeCache() {}
+
+const DecodedInst &DecodeCache::lookup(uint64_t pc, Simulator *simu) {
+  uint64_t pageNum = pc >> PAGE_BITS;
+  if (this->lastPage == nullptr || this->lastPageNum != pageNum) {
+    std::vector<DecodedInst> &page = this->pages[pageNum];
+    if (page.empty()) {
+      page.resize(SLOTS_PER_PAGE);
+    }
+    this->lastPage = &page;
+    this->lastPageNum = pageNum;
+  }
+
+  DecodedInst &entry = (*this->lastPage)[(pc >> 2) & (SLOTS_PER_PAGE - 1)];
+  if (entry.valid) {
+    this->hits++;
+    return entry;
+  }
+  this->misses++;
+  this->fill(entry, pc, simu);
+  return entry;
+}
+
+void DecodeCache::fill(DecodedInst &entry, uint64_t pc, Simulator *simu) {
+  uint32_t inst = simu->memory->getInt(pc);
+  DecodedOp op;
+  entry.inst = inst;
+  if (!decodeInst(inst, &op)) {
+    // Issue decides whether this is a wrong-path fetch or a real error
+    entry.opType = UNKNOWN;
+    entry.valid = true;
+    return;
+  }
+
+  entry.opType = op.instType;
+  entry.destReg = op.rd;
+  entry.srcReg1 = op.rs1;
+  entry.srcReg2 = op.rs2;
+  entry.op1FromReg = readsRs1(op.format);
+  entry.op2FromReg = readsRs2(op.format);
+  entry.op1 = op.imm;
+  entry.op2 = op.format == I_TYPE ? op.imm : 0;
+  entry.offset = op.imm;
+  entry.fuType = instInfo(op.instType).fu;
+  entry.valid = true;
+}
+
+void DecodeCache::invalidate(uint64_t addr, uint32_t len) {
+  // Only the slots the store overlaps, code and data often share a page
+  uint64_t firstSlot = addr >> 2;
+  uint64_t lastSlot = (addr + len - 1) >> 2;
+  for (uint64_t slot = firstSlot; slot <= lastSlot; ++slot) {
+    auto it = this->pages.find(slot >> (PAGE_BITS - 2));
+    if (it == this->pages.end()) {
+      continue;
+    }
+    DecodedInst &entry = it->second[slot & (SLOTS_PER_PAGE - 1)];
+    if (entry.valid) {
+      entry.valid = false;
+      this->invalidations++;
+    }
+  }
+}
+
+void DecodeCache::clear() {
+  this->pages.clear();
+  this->lastPage = nullptr;
+}
@@ -0,0 +1,58 @@
+/*
+ * PC-indexed cache of predecoded instructions
+ *
+ * Only the static part of an instruction is kept here (type, register
+ * indices, immediates and FU class). Register values are read at issue time,
+ * so an entry stays valid until a store overwrites the instruction.
+ */
+
+#ifndef DECODE_CACHE_H
+#define DECODE_CACHE_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "Tomasulo.h"
+#include "riscv.h"
+
+class Simulator;
+
+struct DecodedInst {
+  bool valid = false;
+  uint32_t inst = 0;
+  RISCV::InstType opType = RISCV::UNKNOWN;
+  RISCV::RegId destReg = 0;
+  RISCV::RegId srcReg1 = 0;
+  RISCV::RegId srcReg2 = 0;
+  bool op1FromReg = false; // otherwise op1 is the immediate below
+  bool op2FromReg = false; // otherwise op2 is the immediate below
+  int64_t op1 = 0, op2 = 0, offset = 0;
+  FunctionUnitType fuType = FunctionUnitType::NONE;
+};
+
+class DecodeCache {
+public:
+  DecodeCache();
+  ~DecodeCache();
+
+  const DecodedInst &lookup(uint64_t pc, Simulator *simu);
+  void invalidate(uint64_t addr, uint32_t len);
+  void clear();
+
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t invalidations = 0;
+
+private:
+  static const int PAGE_BITS = 12;
+  static const int SLOTS_PER_PAGE = (1 << PAGE_BITS) / 4;
+
+  void fill(DecodedInst &entry, uint64_t pc, Simulator *simu);
+
+  std::unordered_map<uint64_t, std::vector<DecodedInst>> pages;
+  uint64_t lastPageNum = 0;
+  std::vector<DecodedInst> *lastPage = nullptr;
+};
+
+#endif
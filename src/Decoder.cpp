@@ -0,0 +1,245 @@
+#include "Decoder.h"
+
+#include <cstdio>
+#include <string>
+
+namespace RISCV {
+
+namespace {
+
+constexpr int ANY = -1;
+
+struct DecodeRule {
+  int opcode;
+  int funct3; // ANY if the field is not part of the encoding
+  int funct7; // ANY if the field is not part of the encoding
+  InstType instType;
+  InstLargeType format;
+};
+
+constexpr DecodeRule RULES[] = {
+    {OP_LUI, ANY, ANY, LUI, U_TYPE},
+    {OP_AUIPC, ANY, ANY, AUIPC, U_TYPE},
+    {OP_JAL, ANY, ANY, JAL, UJ_TYPE},
+    {OP_JALR, 0x0, ANY, JALR, I_TYPE},
+
+    {OP_BRANCH, 0x0, ANY, BEQ, SB_TYPE},
+    {OP_BRANCH, 0x1, ANY, BNE, SB_TYPE},
+    {OP_BRANCH, 0x4, ANY, BLT, SB_TYPE},
+    {OP_BRANCH, 0x5, ANY, BGE, SB_TYPE},
+    {OP_BRANCH, 0x6, ANY, BLTU, SB_TYPE},
+    {OP_BRANCH, 0x7, ANY, BGEU, SB_TYPE},
+
+    {OP_LOAD, 0x0, ANY, LB, I_TYPE},
+    {OP_LOAD, 0x1, ANY, LH, I_TYPE},
+    {OP_LOAD, 0x2, ANY, LW, I_TYPE},
+    {OP_LOAD, 0x3, ANY, LD, I_TYPE},
+    {OP_LOAD, 0x4, ANY, LBU, I_TYPE},
+    {OP_LOAD, 0x5, ANY, LHU, I_TYPE},
+    {OP_LOAD, 0x6, ANY, LWU, I_TYPE},
+
+    {OP_STORE, 0x0, ANY, SB, S_TYPE},
+    {OP_STORE, 0x1, ANY, SH, S_TYPE},
+    {OP_STORE, 0x2, ANY, SW, S_TYPE},
+    {OP_STORE, 0x3, ANY, SD, S_TYPE},
+
+    {OP_IMM, 0x0, ANY, ADDI, I_TYPE},
+    {OP_IMM, 0x2, ANY, SLTI, I_TYPE},
+    {OP_IMM, 0x3, ANY, SLTIU, I_TYPE},
+    {OP_IMM, 0x4, ANY, XORI, I_TYPE},
+    {OP_IMM, 0x6, ANY, ORI, I_TYPE},
+    {OP_IMM, 0x7, ANY, ANDI, I_TYPE},
+    {OP_IMM, 0x1, 0x00, SLLI, I_TYPE},
+    {OP_IMM, 0x5, 0x00, SRLI, I_TYPE},
+    {OP_IMM, 0x5, 0x20, SRAI, I_TYPE},
+
+    {OP_REG, 0x0, 0x00, ADD, R_TYPE},
+    {OP_REG, 0x0, 0x20, SUB, R_TYPE},
+    {OP_REG, 0x1, 0x00, SLL, R_TYPE},
+    {OP_REG, 0x2, 0x00, SLT, R_TYPE},
+    {OP_REG, 0x3, 0x00, SLTU, R_TYPE},
+    {OP_REG, 0x4, 0x00, XOR, R_TYPE},
+    {OP_REG, 0x5, 0x00, SRL, R_TYPE},
+    {OP_REG, 0x5, 0x20, SRA, R_TYPE},
+    {OP_REG, 0x6, 0x00, OR, R_TYPE},
+    {OP_REG, 0x7, 0x00, AND, R_TYPE},
+    {OP_REG, 0x0, 0x01, MUL, R_TYPE},
+    {OP_REG, 0x1, 0x01, MULH, R_TYPE},
+    {OP_REG, 0x4, 0x01, DIV, R_TYPE},
+    {OP_REG, 0x6, 0x01, REM, R_TYPE},
+
+    {OP_SYSTEM, 0x0, 0x00, ECALL, R_TYPE},
+
+    {OP_IMM32, 0x0, ANY, ADDIW, I_TYPE},
+    {OP_IMM32, 0x1, 0x00, SLLIW, I_TYPE},
+    {OP_IMM32, 0x5, 0x00, SRLIW, I_TYPE},
+    {OP_IMM32, 0x5, 0x20, SRAIW, I_TYPE},
+
+    {OP_32, 0x0, 0x00, ADDW, R_TYPE},
+    {OP_32, 0x0, 0x20, SUBW, R_TYPE},
+    {OP_32, 0x1, 0x00, SLLW, R_TYPE},
+    {OP_32, 0x5, 0x00, SRLW, R_TYPE},
+    {OP_32, 0x5, 0x20, SRAW, R_TYPE},
+};
+
+// funct7 only ever takes the values 0x00, 0x20 and 0x01 in the supported
+// subset, so it is folded into a 2 bit selector (3 means anything else)
+constexpr int funct7Selector(int funct7) {
+  return funct7 == 0x00 ? 0 : funct7 == 0x20 ? 1 : funct7 == 0x01 ? 2 : 3;
+}
+
+// RV64 OP_IMM shifts keep shamt[5] in the lowest funct7 bit
+constexpr int funct7Mask(int opcode) { return opcode == OP_IMM ? 0x7E : 0x7F; }
+
+struct DecodeEntry {
+  int8_t instType = UNKNOWN;
+  uint8_t format = R_TYPE;
+};
+
+// Indexed by opcode[6:2], funct3 and the funct7 selector
+struct DecodeTable {
+  DecodeEntry entries[32 * 8 * 4];
+  uint8_t funct7Sel[128];
+
+  constexpr DecodeTable() : entries(), funct7Sel() {
+    for (int f7 = 0; f7 < 128; ++f7) {
+      funct7Sel[f7] = funct7Selector(f7);
+    }
+    for (const DecodeRule &rule : RULES) {
+      for (int f3 = 0; f3 < 8; ++f3) {
+        if (rule.funct3 != ANY && rule.funct3 != f3) continue;
+        for (int sel = 0; sel < 4; ++sel) {
+          if (rule.funct7 != ANY && funct7Selector(rule.funct7) != sel)
+            continue;
+          DecodeEntry &entry = entries[(rule.opcode >> 2) << 5 | f3 << 2 | sel];
+          entry.instType = rule.instType;
+          entry.format = rule.format;
+        }
+      }
+    }
+  }
+};
+
+constexpr DecodeTable TABLE;
+
+// Sign extends the low bits of value, shifting unsigned to stay defined
+inline int32_t signExtend(uint32_t value, int bits) {
+  return int32_t(value << (32 - bits)) >> (32 - bits);
+}
+
+} // namespace
+
+bool decodeInst(uint32_t inst, DecodedOp *op) {
+  uint32_t opcode = inst & 0x7F;
+  uint32_t funct3 = (inst >> 12) & 0x7;
+  uint32_t funct7 = (inst >> 25) & funct7Mask(opcode);
+  if ((opcode & 0x3) != 0x3) {
+    return false;
+  }
+
+  const DecodeEntry &entry =
+      TABLE.entries[(opcode >> 2) << 5 | funct3 << 2 | TABLE.funct7Sel[funct7]];
+  if (entry.instType == UNKNOWN) {
+    return false;
+  }
+
+  InstType instType = (InstType)entry.instType;
+  InstLargeType format = (InstLargeType)entry.format;
+  op->instType = instType;
+  op->format = format;
+  op->rd = writesRd(format) ? (inst >> 7) & 0x1F : 0;
+  op->rs1 = readsRs1(format) ? (inst >> 15) & 0x1F : 0;
+  op->rs2 = readsRs2(format) ? (inst >> 20) & 0x1F : 0;
+
+  switch (format) {
+  case I_TYPE:
+    op->imm = int32_t(inst) >> 20;
+    break;
+  case S_TYPE:
+    op->imm = signExtend(((inst >> 7) & 0x1F) | ((inst >> 20) & 0xFE0), 12);
+    break;
+  case SB_TYPE:
+    op->imm = signExtend(((inst >> 7) & 0x1E) | ((inst >> 20) & 0x7E0) |
+                             ((inst << 4) & 0x800) | ((inst >> 19) & 0x1000),
+                         13);
+    break;
+  case U_TYPE:
+    op->imm = int32_t(inst) >> 12;
+    break;
+  case UJ_TYPE:
+    op->imm = signExtend(((inst >> 21) & 0x3FF) | ((inst >> 10) & 0x400) |
+                             ((inst >> 1) & 0x7F800) | ((inst >> 12) & 0x80000),
+                         20) * 2;
+    break;
+  default:
+    op->imm = 0;
+    break;
+  }
+
+  switch (instType) {
+  case SLLI:
+  case SRLI:
+  case SRAI:
+    op->imm &= 0x3F;
+    break;
+  case SLLIW:
+  case SRLIW:
+  case SRAIW:
+    op->imm &= 0x1F;
+    break;
+  case ECALL:
+    // syscall number in a7, argument and result in a0
+    if ((inst >> 20) != 0) {
+      return false;
+    }
+    op->rd = REG_A0;
+    op->rs1 = REG_A0;
+    op->rs2 = REG_A7;
+    break;
+  default:
+    break;
+  }
+  return true;
+}
+
+int disassemble(uint32_t inst, char *buf, size_t size) {
+  DecodedOp op;
+  if (!decodeInst(inst, &op)) {
+    return snprintf(buf, size, "unknown");
+  }
+
+  const char *name = INSTNAME[op.instType];
+  const char *rd = REGNAME[op.rd];
+  const char *rs1 = REGNAME[op.rs1];
+  const char *rs2 = REGNAME[op.rs2];
+  long long imm = op.imm;
+
+  if (op.instType == ECALL) {
+    return snprintf(buf, size, "%s", name);
+  }
+  switch (op.format) {
+  case R_TYPE:
+    return snprintf(buf, size, "%s %s,%s,%s", name, rd, rs1, rs2);
+  case I_TYPE:
+    if ((op.instType >= LB && op.instType <= LHU) || op.instType == LWU) {
+      return snprintf(buf, size, "%s %s,%lld(%s)", name, rd, imm, rs1);
+    }
+    return snprintf(buf, size, "%s %s,%s,%lld", name, rd, rs1, imm);
+  case S_TYPE:
+    return snprintf(buf, size, "%s %s,%lld(%s)", name, rs2, imm, rs1);
+  case SB_TYPE:
+    return snprintf(buf, size, "%s %s,%s,%lld", name, rs1, rs2, imm);
+  case U_TYPE:
+  case UJ_TYPE:
+    return snprintf(buf, size, "%s %s,%lld", name, rd, imm);
+  }
+  return snprintf(buf, size, "%s", name);
+}
+
+std::string disassemble(uint32_t inst) {
+  char buf[DISASM_MAX];
+  disassemble(inst, buf, sizeof(buf));
+  return buf;
+}
+
+} // namespace RISCV
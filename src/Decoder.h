@@ -0,0 +1,55 @@
+/*
+ * RV64I(M) instruction decoder shared by the Tomasulo and scoreboard cores
+ *
+ * Decoding is driven by a table built at compile time from
+ * (opcode, funct3, funct7) rules, so decoding an instruction is a couple of
+ * indexed loads plus immediate extraction. No strings are built here, use
+ * disassemble() when a human readable form is needed.
+ */
+
+#ifndef DECODER_H
+#define DECODER_H
+
+#include <cstdint>
+#include <string>
+
+#include "riscv.h"
+
+namespace RISCV {
+
+// Compact decode result, plain old data
+struct DecodedOp {
+  InstType instType;
+  InstLargeType format; // operand format, tells which fields are meaningful
+  RegId rd;             // 0 when the format has no destination
+  RegId rs1;            // 0 when the format has no first source
+  RegId rs2;            // 0 when the format has no second source
+  int64_t imm;          // sign extended immediate (shamt for shifts)
+};
+
+inline bool readsRs1(InstLargeType format) {
+  return format != U_TYPE && format != UJ_TYPE;
+}
+
+inline bool readsRs2(InstLargeType format) {
+  return format == R_TYPE || format == S_TYPE || format == SB_TYPE;
+}
+
+inline bool writesRd(InstLargeType format) {
+  return format == R_TYPE || format == I_TYPE || format == U_TYPE ||
+         format == UJ_TYPE;
+}
+
+// Returns false for encodings outside the supported subset
+bool decodeInst(uint32_t inst, DecodedOp *op);
+
+// Longest disassembly, terminating zero included
+const int DISASM_MAX = 64;
+
+// Writes the disassembly to buf like snprintf, no allocation
+int disassemble(uint32_t inst, char *buf, size_t size);
+std::string disassemble(uint32_t inst);
+
+} // namespace RISCV
+
+#endif
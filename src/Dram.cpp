@@ -0,0 +1,133 @@
+#include "Dram.h"
+
+#include <algorithm>
+#include <cstdio>
+
+Dram::Dram(const DramConfig &config, int lineSize) : config(config) {
+  this->lineBits = 0;
+  while ((1 << this->lineBits) < lineSize) {
+    this->lineBits++;
+  }
+  this->linesPerRow = std::max(config.rowBytes / lineSize, 1);
+  this->channels.resize(config.channels);
+  this->banks.resize(config.channels * config.banks);
+}
+
+uint64_t Dram::enqueue(Channel &channel, uint64_t cycle) {
+  while (true) {
+    auto started = [cycle](uint64_t start) { return start <= cycle; };
+    channel.pending.erase(std::remove_if(channel.pending.begin(),
+                                         channel.pending.end(), started),
+                          channel.pending.end());
+    if ((int)channel.pending.size() < this->config.queueSize) {
+      return cycle;
+    }
+    cycle = *std::min_element(channel.pending.begin(), channel.pending.end());
+  }
+}
+
+uint32_t Dram::access(uint64_t addr, bool isWrite, uint64_t cycle) {
+  if (isWrite) {
+    this->writes++;
+  } else {
+    this->reads++;
+  }
+  const DramConfig &c = this->config;
+  uint64_t line = addr >> this->lineBits;
+  uint64_t rest = line / this->linesPerRow;
+  int channelIndex = rest % c.channels;
+  Channel &channel = this->channels[channelIndex];
+  rest /= c.channels;
+  Bank &bank = this->banks[channelIndex * c.banks + rest % c.banks];
+  uint64_t row = rest / c.banks;
+
+  uint64_t arrival = this->enqueue(channel, cycle);
+  this->queueFullCycles += arrival - cycle;
+
+  // activations the bank has finished with no longer matter, the last one
+  // is kept for the open row
+  std::deque<Window> &plan = bank.plan;
+  while (plan.size() > 1 && plan[1].activate - c.tRP <= arrival) {
+    plan.pop_front();
+  }
+
+  // first ready: join an activation of the same row that is still open
+  uint64_t column = 0;
+  uint64_t firstCommand = 0;
+  size_t i = 0;
+  for (; i < plan.size(); ++i) {
+    if (plan[i].row != row) {
+      continue;
+    }
+    uint64_t closes = i + 1 < plan.size() ? plan[i + 1].activate - c.tRP
+                      : c.openPage         ? UINT64_MAX
+                                           : plan[i].lastColumn + c.tBurst;
+    if (arrival < closes) {
+      break;
+    }
+  }
+  if (i < plan.size()) {
+    Window &w = plan[i];
+    column = std::max({arrival, w.lastColumn + c.tBurst, w.activate + c.tRCD});
+    w.lastColumn = column;
+    firstCommand = column;
+    this->rowHits++;
+    if (i + 1 < plan.size()) {
+      // later activations wait until this column access is done
+      this->reordered++;
+      uint64_t precharge = plan[i + 1].activate - c.tRP;
+      if (column + c.tBurst > precharge) {
+        uint64_t shift = column + c.tBurst - precharge;
+        for (size_t j = i + 1; j < plan.size(); ++j) {
+          plan[j].activate += shift;
+          plan[j].lastColumn += shift;
+        }
+      }
+    }
+  } else {
+    // first come first served behind the bank's committed work
+    Window w;
+    w.row = row;
+    if (plan.empty()) {
+      w.activate = arrival;
+      firstCommand = arrival;
+      this->rowEmpty++;
+    } else if (c.openPage) {
+      firstCommand = std::max(arrival, plan.back().lastColumn + c.tBurst);
+      w.activate = firstCommand + c.tRP;
+      this->rowConflicts++;
+    } else {
+      // closed page precharges right after the last column access
+      w.activate = std::max(arrival, plan.back().lastColumn + c.tBurst + c.tRP);
+      firstCommand = w.activate;
+      this->rowEmpty++;
+    }
+    column = w.activate + c.tRCD;
+    w.lastColumn = column;
+    plan.push_back(w);
+  }
+  channel.pending.push_back(firstCommand);
+  this->queueCycles += firstCommand - cycle;
+
+  uint64_t data = std::max(column + c.tCAS, channel.busFree);
+  channel.busFree = data + c.tBurst;
+  uint32_t latency = data + c.tBurst - cycle;
+  this->latencySum += latency;
+  return latency;
+}
+
+void Dram::printStatistics() const {
+  uint64_t requests = this->reads + this->writes;
+  printf("DRAM: %d channels x %d banks, %dB rows, %s page, requests: %lu "
+         "(%lu writes), row hits: %lu (%.2f%%), empty: %lu, conflicts: %lu, "
+         "reordered: %lu\n",
+         this->config.channels, this->config.banks, this->config.rowBytes,
+         this->config.openPage ? "open" : "closed", requests, this->writes,
+         this->rowHits, requests > 0 ? 100.0 * this->rowHits / requests : 0.0,
+         this->rowEmpty, this->rowConflicts, this->reordered);
+  printf("DRAM: avg queueing latency: %.2f cycles, avg latency: %.2f cycles, "
+         "queue full cycles: %lu\n",
+         requests > 0 ? (double)this->queueCycles / requests : 0.0,
+         requests > 0 ? (double)this->latencySum / requests : 0.0,
+         this->queueFullCycles);
+}
@@ -0,0 +1,70 @@
+/*
+ * DRAM timing model behind the last level cache
+ *
+ * Lines are mapped as row | bank | channel | column, so consecutive lines
+ * share a row. Every bank keeps the plan of row activations it already
+ * committed to. The controller is FR-FCFS: a request to a row that is open,
+ * or planned to be open, when it arrives joins that activation ahead of
+ * older requests to other rows, everything else is served in order.
+ *
+ * Latencies are fixed when a request arrives, so requests that a later row
+ * hit overtakes keep the latency they were given.
+ */
+
+#ifndef DRAM_H
+#define DRAM_H
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "Config.h"
+
+class Dram {
+public:
+  Dram(const DramConfig &config, int lineSize);
+
+  // Returns the cycles from cycle until the line is transferred
+  uint32_t access(uint64_t addr, bool isWrite, uint64_t cycle);
+
+  void printStatistics() const;
+
+  // statistics
+  uint64_t reads = 0;
+  uint64_t writes = 0;
+  uint64_t rowHits = 0;
+  uint64_t rowEmpty = 0;     // bank precharged, activate only
+  uint64_t rowConflicts = 0; // another row open, precharge and activate
+  uint64_t reordered = 0;    // row hits served ahead of older requests
+  uint64_t queueFullCycles = 0;
+  uint64_t queueCycles = 0;  // arrival until the first command, summed
+  uint64_t latencySum = 0;
+
+private:
+  // One row activation a bank committed to
+  struct Window {
+    uint64_t row;
+    uint64_t activate;
+    uint64_t lastColumn; // latest column command issued to the row
+  };
+
+  struct Bank {
+    std::deque<Window> plan; // the last window holds the open row
+  };
+
+  struct Channel {
+    uint64_t busFree = 0;
+    std::vector<uint64_t> pending; // first command cycle of queued requests
+  };
+
+  // Waits for a free queue entry, returns the cycle the request gets one
+  uint64_t enqueue(Channel &channel, uint64_t cycle);
+
+  DramConfig config;
+  int lineBits;
+  uint64_t linesPerRow;
+  std::vector<Channel> channels;
+  std::vector<Bank> banks; // channels * banks
+};
+
+#endif
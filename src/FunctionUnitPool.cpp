@@ -0,0 +1,40 @@
+#include "FunctionUnitPool.h"
+
+const char *FU_NAME[FU_TYPE_COUNT] = {"none", "alu",  "mul",  "div",
+                                      "branch", "load", "store"};
+
+FunctionUnitPool::FunctionUnitPool(const SimConfig &config) {
+  for (int t = 0; t < FU_TYPE_COUNT; ++t) {
+    this->units[t].resize(config.fuCount[t]);
+    this->pipelined[t] = config.fuPipelined[t];
+  }
+}
+
+bool FunctionUnitPool::acquire(FunctionUnitType type, int latency,
+                               uint64_t cycle, int *unit) {
+  int t = (int)type;
+  for (size_t i = 0; i < this->units[t].size(); ++i) {
+    Unit &u = this->units[t][i];
+    bool free = this->pipelined[t] ? u.lastStart != cycle
+                                   : u.busyUntil <= cycle;
+    if (!free) {
+      continue;
+    }
+    u.lastStart = cycle;
+    u.busyUntil = cycle + latency;
+    this->ops[t]++;
+    this->busyCycles[t] += this->pipelined[t] ? 1 : latency;
+    *unit = i;
+    return true;
+  }
+  this->structuralStalls[t]++;
+  return false;
+}
+
+int FunctionUnitPool::count(FunctionUnitType type) const {
+  return this->units[(int)type].size();
+}
+
+bool FunctionUnitPool::isPipelined(FunctionUnitType type) const {
+  return this->pipelined[(int)type];
+}
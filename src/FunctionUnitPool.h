@@ -0,0 +1,43 @@
+/*
+ * Functional units shared by the reservation stations
+ *
+ * A pipelined unit accepts a new operation every cycle, a blocking one stays
+ * busy until its current operation finishes.
+ */
+
+#ifndef FUNCTION_UNIT_POOL_H
+#define FUNCTION_UNIT_POOL_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Config.h"
+#include "riscv.h"
+
+class FunctionUnitPool {
+public:
+  explicit FunctionUnitPool(const SimConfig &config);
+
+  // Claims a unit for an operation starting this cycle, false on a
+  // structural hazard. unit gets its index among the units of type.
+  bool acquire(FunctionUnitType type, int latency, uint64_t cycle, int *unit);
+
+  int count(FunctionUnitType type) const;
+  bool isPipelined(FunctionUnitType type) const;
+
+  // statistics, indexed by FunctionUnitType
+  uint64_t ops[FU_TYPE_COUNT] = {0};
+  uint64_t busyCycles[FU_TYPE_COUNT] = {0};
+  uint64_t structuralStalls[FU_TYPE_COUNT] = {0};
+
+private:
+  struct Unit {
+    uint64_t busyUntil = 0;          // first cycle a blocking unit is free
+    uint64_t lastStart = UINT64_MAX; // cycle of the latest operation start
+  };
+
+  std::vector<Unit> units[FU_TYPE_COUNT];
+  bool pipelined[FU_TYPE_COUNT];
+};
+
+#endif
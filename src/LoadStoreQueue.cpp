@@ -0,0 +1,199 @@
+#include "LoadStoreQueue.h"
+
+#include <algorithm>
+
+using namespace RISCV;
+
+LoadStoreQueue::LoadStoreQueue(int size) : entries(size) {}
+
+int LoadStoreQueue::accessSize(InstType type) {
+  switch (type) {
+  case LB:
+  case LBU:
+  case SB:
+    return 1;
+  case LH:
+  case LHU:
+  case SH:
+    return 2;
+  case LW:
+  case LWU:
+  case SW:
+    return 4;
+  default:
+    return 8;
+  }
+}
+
+int LoadStoreQueue::allocate(int robIndex, InstType type, uint64_t pc) {
+  int index = this->tail;
+  Entry &e = this->entries[index];
+  e = Entry();
+  e.robIndex = robIndex;
+  e.seq = this->nextSeq++;
+  e.pc = pc;
+  e.type = type;
+  e.isStore = isWriteMem(type);
+  e.size = accessSize(type);
+  this->tail = (this->tail + 1) % this->entries.size();
+  this->count++;
+  return index;
+}
+
+void LoadStoreQueue::release(int index) {
+  // commit is in order, so this is always the head
+  this->entries[index] = Entry();
+  this->head = (this->head + 1) % this->entries.size();
+  this->count--;
+}
+
+void LoadStoreQueue::setAddress(int index, uint64_t addr) {
+  this->entries[index].addr = addr;
+  this->entries[index].addrValid = true;
+}
+
+void LoadStoreQueue::setStoreData(int index, uint64_t data) {
+  this->entries[index].data = data;
+  this->entries[index].dataValid = true;
+}
+
+void LoadStoreQueue::setDependence(int index, int storeIndex, uint64_t storeSeq) {
+  this->entries[index].dependIndex = storeIndex;
+  this->entries[index].dependSeq = storeSeq;
+}
+
+const LoadStoreQueue::Entry *LoadStoreQueue::findStore(int index,
+                                                       uint64_t addr) const {
+  for (int i = index; i != this->head;) {
+    i = this->prev(i);
+    const Entry &e = this->entries[i];
+    if (e.isStore && e.addrValid && addr >= e.addr && addr < e.addr + e.size) {
+      return &e;
+    }
+  }
+  return nullptr;
+}
+
+LoadStoreQueue::LoadCheck LoadStoreQueue::checkLoad(int index,
+                                                    bool speculative) const {
+  const Entry &load = this->entries[index];
+  if (speculative) {
+    const Entry &dep = this->entries[std::max(load.dependIndex, 0)];
+    if (load.dependIndex >= 0 && dep.seq == load.dependSeq && !dep.addrValid) {
+      return LoadCheck::BLOCKED_ADDR;
+    }
+  } else {
+    for (int i = index; i != this->head;) {
+      i = this->prev(i);
+      const Entry &e = this->entries[i];
+      if (e.isStore && !e.addrValid) {
+        return LoadCheck::BLOCKED_ADDR;
+      }
+    }
+  }
+
+  int forwarded = 0;
+  for (int b = 0; b < load.size; ++b) {
+    const Entry *store = this->findStore(index, load.addr + b);
+    if (store == nullptr) {
+      continue;
+    }
+    if (!store->dataValid) {
+      return LoadCheck::BLOCKED_DATA;
+    }
+    forwarded++;
+  }
+  if (forwarded == 0) {
+    return LoadCheck::READY;
+  }
+  return forwarded == load.size ? LoadCheck::FORWARD : LoadCheck::PARTIAL;
+}
+
+int64_t LoadStoreQueue::forwardLoad(int index, int64_t memValue) const {
+  const Entry &load = this->entries[index];
+  uint64_t value = (uint64_t)memValue;
+  for (int b = 0; b < load.size; ++b) {
+    const Entry *store = this->findStore(index, load.addr + b);
+    if (store == nullptr || !store->dataValid) {
+      // a store resolved since the check, the load is replayed anyway
+      continue;
+    }
+    uint64_t byte = (store->data >> ((load.addr + b - store->addr) * 8)) & 0xFF;
+    value = (value & ~(0xFFULL << (b * 8))) | (byte << (b * 8));
+  }
+
+  switch (load.type) {
+  case LB:
+    return (int8_t)value;
+  case LH:
+    return (int16_t)value;
+  case LW:
+    return (int32_t)value;
+  case LBU:
+    return (uint8_t)value;
+  case LHU:
+    return (uint16_t)value;
+  case LWU:
+    return (uint32_t)value;
+  default:
+    return value;
+  }
+}
+
+void LoadStoreQueue::markExecuted(int index) {
+  Entry &load = this->entries[index];
+  load.executed = true;
+  for (int i = index; i != this->head;) {
+    i = this->prev(i);
+    if (this->entries[i].isStore && !this->entries[i].addrValid) {
+      this->speculativeLoadCount++;
+      break;
+    }
+  }
+}
+
+int LoadStoreQueue::findViolation(int storeIndex) const {
+  const Entry &store = this->entries[storeIndex];
+  int size = this->entries.size();
+  for (int i = (storeIndex + 1) % size; i != this->tail; i = (i + 1) % size) {
+    const Entry &load = this->entries[i];
+    if (load.isStore || !load.executed) {
+      continue;
+    }
+    if (load.addr >= store.addr + store.size || store.addr >= load.addr + load.size) {
+      continue;
+    }
+    // Stale only if no store in between supplied the overlapping bytes
+    for (int b = 0; b < load.size; ++b) {
+      if (this->findStore(i, load.addr + b) == &store) {
+        return i;
+      }
+    }
+  }
+  return -1;
+}
+
+void LoadStoreQueue::noteBlocked(int index, LoadCheck check) {
+  Entry &load = this->entries[index];
+  if (!load.wasBlocked) {
+    load.wasBlocked = true;
+    this->blockedLoadCount++;
+  }
+  if (check == LoadCheck::BLOCKED_ADDR) {
+    this->blockedAddrCycles++;
+    if (load.dependIndex >= 0) {
+      this->predictedWaitCycles++;
+    }
+  } else {
+    this->blockedDataCycles++;
+  }
+}
+
+void LoadStoreQueue::noteExecuted(LoadCheck check) {
+  this->loadCount++;
+  if (check == LoadCheck::FORWARD) {
+    this->forwardCount++;
+  } else if (check == LoadCheck::PARTIAL) {
+    this->partialForwardCount++;
+  }
+}
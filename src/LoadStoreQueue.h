@@ -0,0 +1,128 @@
+/*
+ * Load/store queue holding every in-flight memory instruction in program
+ * order, from issue until commit
+ *
+ * Loads are disambiguated against the older stores: they bypass stores to
+ * other addresses and take the bytes of overlapping ones, merging partial
+ * overlaps with memory. A load may also be let past stores whose address is
+ * still unknown, the store then checks for the violation once it resolves.
+ */
+
+#ifndef LOAD_STORE_QUEUE_H
+#define LOAD_STORE_QUEUE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "riscv.h"
+
+class LoadStoreQueue {
+public:
+  enum class LoadCheck {
+    READY,        // no older store overlaps, read memory
+    FORWARD,      // every byte comes from older stores
+    PARTIAL,      // some bytes from older stores, the rest from memory
+    BLOCKED_ADDR, // an older store address is still unknown
+    BLOCKED_DATA, // an overlapping older store has no data yet
+  };
+
+  explicit LoadStoreQueue(int size);
+
+  bool full() const { return this->count == (int)this->entries.size(); }
+  bool empty() const { return this->count == 0; }
+
+  // Returns the queue index, the queue must not be full
+  int allocate(int robIndex, RISCV::InstType type, uint64_t pc);
+  // Frees the oldest entry when its instruction commits
+  void release(int index);
+  // Drops entries from the tail while isSquashed(robIndex) holds
+  template <typename F> int squash(F isSquashed);
+
+  void setAddress(int index, uint64_t addr);
+  void setStoreData(int index, uint64_t data);
+  // The store a load has to wait for, from the memory dependence predictor
+  void setDependence(int index, int storeIndex, uint64_t storeSeq);
+
+  bool isStore(int index) const { return this->entries[index].isStore; }
+  uint64_t pcOf(int index) const { return this->entries[index].pc; }
+  int robIndexOf(int index) const { return this->entries[index].robIndex; }
+  // Allocation sequence number, tells a live entry from a reused slot
+  uint64_t seqOf(int index) const { return this->entries[index].seq; }
+
+  // The load address must be set, never modifies the queue. A speculative
+  // check ignores unknown store addresses except the one of the store the
+  // load was predicted to depend on
+  LoadCheck checkLoad(int index, bool speculative) const;
+  // Marks the load as having read its value, speculatively when an older
+  // store address is still unknown
+  void markExecuted(int index);
+  // Called once the store address is set, returns the index of the oldest
+  // younger load that already read the bytes this store writes, -1 if none
+  int findViolation(int storeIndex) const;
+  // Overlays the bytes of older stores on the value read from memory and
+  // redoes the sign extension of the load
+  int64_t forwardLoad(int index, int64_t memValue) const;
+
+  static int accessSize(RISCV::InstType type);
+
+  // statistics
+  uint64_t loadCount = 0;
+  uint64_t forwardCount = 0;      // loads fully served by older stores
+  uint64_t partialForwardCount = 0;
+  uint64_t blockedAddrCycles = 0; // cycles loads waited on store addresses
+  uint64_t blockedDataCycles = 0; // cycles loads waited on store data
+  uint64_t blockedLoadCount = 0;  // loads that waited at least once
+  uint64_t fullStallCount = 0;    // issue stalled on a full queue
+  uint64_t speculativeLoadCount = 0; // loads that passed an unknown store
+  uint64_t predictedWaitCycles = 0;  // cycles loads waited on a predicted store
+
+  // Counts a failed check of the load at index
+  void noteBlocked(int index, LoadCheck check);
+  // Counts the outcome of the check the load finally executed with
+  void noteExecuted(LoadCheck check);
+
+private:
+  struct Entry {
+    int robIndex = -1;
+    uint64_t seq = 0; // 0 for a free entry
+    uint64_t pc = 0;
+    RISCV::InstType type = RISCV::UNKNOWN;
+    bool isStore = false;
+    int size = 0;
+    bool addrValid = false;
+    uint64_t addr = 0;
+    bool dataValid = false;
+    uint64_t data = 0;
+    bool wasBlocked = false;
+    bool executed = false;  // load has read its value
+    int dependIndex = -1;   // predicted store dependence
+    uint64_t dependSeq = 0;
+  };
+
+  int prev(int index) const {
+    return (index - 1 + (int)this->entries.size()) % (int)this->entries.size();
+  }
+  // Youngest older store writing byte addr, nullptr when memory holds it
+  const Entry *findStore(int index, uint64_t addr) const;
+
+  std::vector<Entry> entries;
+  int head = 0, tail = 0, count = 0;
+  uint64_t nextSeq = 1;
+};
+
+template <typename F> int LoadStoreQueue::squash(F isSquashed) {
+  int dropped = 0;
+  while (this->count > 0) {
+    int last = this->prev(this->tail);
+    if (!isSquashed(this->entries[last].robIndex)) {
+      break;
+    }
+    this->entries[last] = Entry();
+    this->tail = last;
+    this->count--;
+    dropped++;
+  }
+  return dropped;
+}
+
+#endif
@@ -1,28 +1,51 @@
+#include <algorithm>
 #include <cstdarg>
 #include <cstdio>
 #include <cstdlib>
 #include <iostream>
 #include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
 
 #include <elfio/elfio.hpp>
 
+#include "BranchPredictor.h"
+#include "BranchTarget.h"
+#include "Cache.h"
 #include "Debug.h"
+#include "Dram.h"
+#include "FunctionUnitPool.h"
+#include "LoadStoreQueue.h"
 #include "MemoryManager.h"
 #include "Simulator.h"
+#include "StackDistance.h"
+#include "StoreBuffer.h"
+#include "StoreSetPredictor.h"
+
+// Core configuration of one run
+struct RunConfig {
+  SimConfig config;
+  std::string predictorName = "gshare";
+  std::string options; // the command line options that made it
+};
 
 bool parseParameters(int argc, char **argv);
 void printUsage();
+Simulator *buildSimulator(uint64_t entry, const RunConfig &run);
 void printElfInfo(ELFIO::elfio *reader);
-void loadElfToMemory(ELFIO::elfio *reader, MemoryManager *memory);
+void loadElfToMemory(ELFIO::elfio *reader, const char *path,
+                     MemoryManager *memory);
 
 char *elfFile = nullptr;
 bool verbose = 0;
 bool isSingleStep = 0;
 bool dumpHistory = 0;
-uint32_t stackBaseAddr = MEMORYSIZE - MEMORYSIZE/100;
-uint32_t stackSize = MEMORYSIZE/100;
+std::vector<RunConfig> runs(1);
+uint64_t stackBaseAddr = 0x6300000;
+uint64_t stackSize = 0x100000; // 1MB
 MemoryManager memory;
-Simulator simulator(&memory);
 
 int main(int argc, char **argv) {
   if (!parseParameters(argc, argv)) {
@@ -41,26 +64,82 @@ int main(int argc, char **argv) {
     printElfInfo(&reader);
   }
 
-  loadElfToMemory(&reader, &memory);
-
-  simulator.isSingleStep = isSingleStep;
-  simulator.verbose = verbose;
-  simulator.shouldDumpHistory = dumpHistory;
-  simulator.pc = reader.get_entry();
-  simulator.initStack(stackBaseAddr, stackSize);
-  simulator.simulate();
+  loadElfToMemory(&reader, elfFile, &memory);
+  memory.snapshot(); // memory.reset() goes back to the loaded program
 
-  if (dumpHistory) {
-    printf("Dumping history to dump.txt...\n");
-    simulator.dumpHistory();
+  // Later runs start from the loaded image again with a cold core built
+  // from their own configuration, each one behaves like a fresh process
+  int runCount = runs.size();
+  for (int run = 0; run < runCount; ++run) {
+    if (runCount > 1) {
+      printf("============ RUN %d/%d:%s ============\n", run + 1, runCount,
+             runs[run].options.c_str());
+    }
+    if (run > 0) {
+      memory.reset();
+    }
+    Simulator *simulator = buildSimulator(reader.get_entry(), runs[run]);
+    if (run > 0) {
+      simulator->traceFile = "simulation." + std::to_string(run + 1) + ".ndjson";
+    }
+    simulator->simulate();
+    delete simulator;
   }
 
   return 0;
 }
 
+// A simulator with every component built from config and its pipeline,
+// caches and predictors empty
+Simulator *buildSimulator(uint64_t entry, const RunConfig &run) {
+  const SimConfig &config = run.config;
+  Simulator *simulator = new Simulator(&memory);
+  simulator->config = config;
+  simulator->isSingleStep = isSingleStep;
+  simulator->verbose = verbose;
+  simulator->shouldDumpHistory = dumpHistory;
+  if (run.predictorName != "none") {
+    simulator->branchPredictor = BranchPredictor::create(run.predictorName);
+  }
+  simulator->tomasulo = new Tomasulo(config.robSize, config.rsSize, RISCV::REGNUM);
+  simulator->fuPool = new FunctionUnitPool(config);
+  if (config.memoryModel == "dram") {
+    simulator->dram = new Dram(config.dram, config.l2.lineSize);
+  }
+  simulator->l2cache = new Cache("L2", config.l2, nullptr, simulator->dram,
+                                 config.memoryLatency);
+  simulator->icache = new Cache("L1I", config.l1i, simulator->l2cache, nullptr, 0);
+  simulator->dcache = new Cache("L1D", config.l1d, simulator->l2cache, nullptr, 0);
+  if (config.stackProfile) {
+    simulator->instProfile = new StackDistanceProfiler(
+        "I-side", config.stackProfileLine, config.stackProfileMax);
+    simulator->dataProfile = new StackDistanceProfiler(
+        "D-side", config.stackProfileLine, config.stackProfileMax);
+  }
+  simulator->lsq = new LoadStoreQueue(config.lsqSize);
+  simulator->storeBuffer =
+      new StoreBuffer(config.storeBufferSize, std::min(config.l1d.lineSize, 64));
+  if (config.memDependence == "storeset") {
+    simulator->storeSets = new StoreSetPredictor(config.ssitSize, config.lfstSize);
+  }
+  simulator->btb = new BranchTargetBuffer(config.btbEntries, config.btbWays);
+  simulator->ras = new ReturnAddressStack(config.rasDepth);
+  simulator->pc = entry;
+  simulator->initStack(stackBaseAddr, stackSize);
+  return simulator;
+}
+
 bool parseParameters(int argc, char **argv) {
-  // Read Parameters
+  // Read Parameters, every "--" starts the options of another run on top
+  // of the ones before the first "--"
   for (int i = 1; i < argc; ++i) {
+    if (std::string(argv[i]) == "--") {
+      RunConfig next = runs[0];
+      next.options.clear();
+      runs.push_back(next);
+      continue;
+    }
+    RunConfig &run = runs.back();
     if (argv[i][0] == '-') {
       switch (argv[i][1]) {
       case 'v':
@@ -69,6 +148,26 @@ bool parseParameters(int argc, char **argv) {
       case 's':
         isSingleStep = 1;
         break;
+      case 'b':
+        if (i + 1 >= argc) {
+          return false;
+        }
+        run.predictorName = argv[++i];
+        if (run.predictorName != "none") {
+          BranchPredictor *check = BranchPredictor::create(run.predictorName);
+          if (check == nullptr) {
+            return false;
+          }
+          delete check;
+        }
+        run.options += std::string(" -b ") + argv[i];
+        break;
+      case 'c':
+        if (i + 1 >= argc || !run.config.set(argv[++i])) {
+          return false;
+        }
+        run.options += std::string(" -c ") + argv[i];
+        break;
       // case 'd': // useless, just use -v
       //   dumpHistory = 1;
       //   break;
@@ -86,12 +185,24 @@ bool parseParameters(int argc, char **argv) {
   if (elfFile == nullptr) {
     return false;
   }
+  for (const RunConfig &run : runs) {
+    if (!run.config.validate()) {
+      return false;
+    }
+  }
   return true;
 }
 
 void printUsage() {
-  printf("Usage: Simulator riscv-elf-file [-v] [-s]\n");
+  printf("Usage: Simulator riscv-elf-file [-v] [-s] [-b predictor] [-c key=value]... "
+         "[-- [-b predictor] [-c key=value]...]...\n");
   printf("Parameters: \n\t[-v] verbose output \n\t[-s] single step\n");
+  printf("\t[-b none|bimodal|gshare|tage] branch predictor, default gshare\n");
+  printf("\t[-c key=value] set a microarchitecture option\n");
+  printf("\t[-- ...] run the program again in the same process, memory is\n"
+         "\t          reset to the loaded image and the core is built from the\n"
+         "\t          options before the first -- plus the ones after this one\n");
+  runs[0].config.printUsage();
 }
 
 void printElfInfo(ELFIO::elfio *reader) {
@@ -142,31 +253,25 @@ void printElfInfo(ELFIO::elfio *reader) {
   printf("===================================\n");
 }
 
-void loadElfToMemory(ELFIO::elfio *reader, MemoryManager *memory) {
+void loadElfToMemory(ELFIO::elfio *reader, const char *path,
+                     MemoryManager *memory) {
+  int fd = open(path, O_RDONLY); // mapFile fails and we copy if this did
   ELFIO::Elf_Half seg_num = reader->segments.size();
   for (int i = 0; i < seg_num; ++i) {
     const ELFIO::segment *pseg = reader->segments[i];
 
-    uint64_t fullmemsz = pseg->get_memory_size();
-    uint64_t fulladdr = pseg->get_virtual_address();
-    // Our 32bit simulator cannot handle this
-    if (fulladdr + fullmemsz > 0xFFFFFFFF) {
-      dbgprintf(
-          "ELF address space larger than 32bit! Seg %d has max addr of 0x%lx\n",
-          i, fulladdr + fullmemsz);
-      exit(-1);
-    }
-
-    uint32_t filesz = pseg->get_file_size();
-    uint32_t memsz = pseg->get_memory_size();
-    uint32_t addr = (uint32_t)pseg->get_virtual_address();
+    uint64_t filesz = pseg->get_file_size();
+    uint64_t memsz = pseg->get_memory_size();
+    uint64_t addr = pseg->get_virtual_address();
 
-    for (uint32_t p = addr; p < addr + memsz; ++p) {
-      if (p < addr + filesz) {
-        memory->setByte(p, pseg->get_data()[p - addr]);
-      } else {
-        memory->setByte(p, 0);
-      }
+    // file contents are mapped copy on write where the alignment allows,
+    // the zeroed tail (.bss) is only allocated once written
+    if (filesz > 0 && !memory->mapFile(fd, pseg->get_offset(), addr, filesz)) {
+      memory->copyFrom(pseg->get_data(), addr, filesz);
     }
+    memory->fill(addr + filesz, 0, memsz - filesz);
+  }
+  if (fd >= 0) {
+    close(fd); // the mappings stay valid
   }
 }
\ No newline at end of file
@@ -1,111 +1,261 @@
 #include "MemoryManager.h"
 #include "Debug.h"
 
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
 #include <string>
 
+#include <sys/mman.h>
+
 MemoryManager::MemoryManager() {
 
 }
 
 MemoryManager::~MemoryManager() {
+  for (auto &it : this->pages) {
+    if (!it.second.fileBacked) {
+      delete[] it.second.data;
+    }
+    delete[] it.second.backup;
+  }
+  for (auto &m : this->mappings) {
+    munmap(m.first, m.second);
+  }
+}
 
+uint8_t *MemoryManager::findPage(uint64_t addr) {
+  auto it = this->pages.find(addr >> PAGE_BITS);
+  return it == this->pages.end() ? nullptr : it->second.data;
 }
 
-bool MemoryManager::copyFrom(const void *src, uint32_t dest, uint32_t len) {
-  for (uint32_t i = 0; i < len; ++i) {
-    if (!this->isAddrExist(dest + i)) {
-      dbgprintf("Data copy to invalid addr 0x%x!\n", dest + i);
-      return false;
+uint8_t *MemoryManager::touchPage(uint64_t addr) {
+  uint64_t pageNumber = addr >> PAGE_BITS;
+  Page &page = this->pages[pageNumber];
+  if (page.data == nullptr) {
+    page.data = new uint8_t[PAGE_BYTES](); // zero filled
+    // the page may still be mapped to the zero page for reads
+    TlbEntry &e = this->tlbEntry(pageNumber);
+    if (e.readTag == pageNumber) {
+      e.readTag = NO_PAGE;
     }
-    this->setByte(dest + i, ((uint8_t *)src)[i]);
   }
-  return true;
+  if (this->tracking && !page.dirty) {
+    page.dirty = true;
+    // a backup left from an earlier run still equals the snapshot
+    if (page.inImage && page.backup == nullptr) {
+      page.backup = new uint8_t[PAGE_BYTES];
+      memcpy(page.backup, page.data, PAGE_BYTES);
+    }
+    this->dirtyPages.push_back(pageNumber);
+  }
+  return page.data;
 }
 
-bool MemoryManager::setByte(uint32_t addr, uint8_t val) {
-  if (!this->isAddrExist(addr)) {
-    dbgprintf("Byte write to invalid addr 0x%x!\n", addr);
-    return false;
+static const uint8_t zeroPage[MemoryManager::PAGE_BYTES] = {0};
+
+uint8_t *MemoryManager::readPage(uint64_t addr) {
+  this->tlbMisses++;
+  uint64_t pageNumber = addr >> PAGE_BITS;
+  TlbEntry &e = this->tlbEntry(pageNumber);
+  auto it = this->pages.find(pageNumber);
+  e.readTag = pageNumber;
+  if (it == this->pages.end()) {
+    // loads never write through host, the zero page stays zero
+    e.writeTag = NO_PAGE;
+    e.host = const_cast<uint8_t *>(zeroPage);
+  } else {
+    // a clean page takes its first write through writePage
+    bool clean = this->tracking && !it->second.dirty;
+    e.writeTag = clean ? NO_PAGE : pageNumber;
+    e.host = it->second.data;
+  }
+  return e.host;
+}
+
+uint8_t *MemoryManager::writePage(uint64_t addr) {
+  this->tlbMisses++;
+  uint64_t pageNumber = addr >> PAGE_BITS;
+  TlbEntry &e = this->tlbEntry(pageNumber);
+  e.host = this->touchPage(addr);
+  e.readTag = pageNumber;
+  e.writeTag = pageNumber;
+  return e.host;
+}
+
+void MemoryManager::flushTlb() {
+  for (TlbEntry &e : this->tlb) {
+    e = TlbEntry();
+  }
+}
+
+void MemoryManager::snapshot() {
+  for (auto &it : this->pages) {
+    Page &page = it.second;
+    page.inImage = true;
+    page.dirty = false;
+    delete[] page.backup;
+    page.backup = nullptr;
+  }
+  this->dirtyPages.clear();
+  this->tracking = true;
+  // write translations made before now skip the dirty tracking
+  this->flushTlb();
+  this->tlbMisses = 0;
+}
+
+size_t MemoryManager::reset() {
+  size_t restored = this->dirtyPages.size();
+  for (uint64_t pageNumber : this->dirtyPages) {
+    auto it = this->pages.find(pageNumber);
+    Page &page = it->second;
+    if (page.inImage) {
+      memcpy(page.data, page.backup, PAGE_BYTES);
+      page.dirty = false;
+    } else {
+      delete[] page.data;
+      this->pages.erase(it);
+    }
+  }
+  this->dirtyPages.clear();
+  this->flushTlb();
+  this->tlbMisses = 0;
+  return restored;
+}
+
+// guest memory is little endian, the fast paths copy host words as is
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "MemoryManager needs a little endian host"
+#endif
+
+template <typename T> T MemoryManager::load(uint64_t addr) {
+  uint64_t offset = addr & (PAGE_BYTES - 1);
+  T val = 0;
+  if (offset + sizeof(T) <= PAGE_BYTES) {
+    TlbEntry &e = this->tlbEntry(addr >> PAGE_BITS);
+    uint8_t *host = e.readTag == addr >> PAGE_BITS ? e.host : this->readPage(addr);
+    memcpy(&val, host + offset, sizeof(T));
+    return val;
+  }
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    val |= (T)this->getByte(addr + i) << (8 * i);
+  }
+  return val;
+}
+
+template <typename T> void MemoryManager::store(uint64_t addr, T val) {
+  uint64_t offset = addr & (PAGE_BYTES - 1);
+  if (offset + sizeof(T) <= PAGE_BYTES) {
+    TlbEntry &e = this->tlbEntry(addr >> PAGE_BITS);
+    uint8_t *host = e.writeTag == addr >> PAGE_BITS ? e.host : this->writePage(addr);
+    memcpy(host + offset, &val, sizeof(T));
+    return;
+  }
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    this->setByte(addr + i, (val >> (8 * i)) & 0xFF);
+  }
+}
+
+bool MemoryManager::copyFrom(const void *src, uint64_t dest, uint64_t len) {
+  const uint8_t *data = (const uint8_t *)src;
+  while (len > 0) {
+    uint64_t offset = dest & (PAGE_BYTES - 1);
+    uint64_t chunk = std::min(len, PAGE_BYTES - offset);
+    memcpy(this->touchPage(dest) + offset, data, chunk);
+    data += chunk;
+    dest += chunk;
+    len -= chunk;
   }
-  this->memory[addr] = val;
   return true;
 }
 
-uint8_t MemoryManager::getByte(uint32_t addr) {
-  if (!this->isAddrExist(addr)) {
-    dbgprintf("Byte read to invalid addr 0x%x!\n", addr);
+bool MemoryManager::mapFile(int fd, uint64_t offset, uint64_t dest,
+                            uint64_t len) {
+  if (len == 0 || (dest & (PAGE_BYTES - 1)) != (offset & (PAGE_BYTES - 1))) {
     return false;
   }
-  return this->memory[addr];
+  uint64_t first = dest & ~(PAGE_BYTES - 1);
+  uint64_t end = dest + len;
+  size_t mapLength = ((end - first) + PAGE_BYTES - 1) & ~(PAGE_BYTES - 1);
+  void *map = mmap(nullptr, mapLength, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd,
+                   offset - (dest - first));
+  if (map == MAP_FAILED) {
+    return false;
+  }
+  this->mappings.push_back({map, mapLength});
+
+  uint8_t *host = (uint8_t *)map;
+  for (uint64_t page = first; page < end; page += PAGE_BYTES, host += PAGE_BYTES) {
+    uint64_t from = std::max(page, dest);
+    uint64_t to = std::min(page + PAGE_BYTES, end);
+    Page &p = this->pages[page >> PAGE_BITS];
+    if (p.data != nullptr) {
+      // shared with an earlier segment, copy into the page it already has
+      memcpy(p.data + (from - page), host + (from - page), to - from);
+      continue;
+    }
+    // clearing the bytes of other segments copies only the edge pages
+    if (from > page) {
+      memset(host, 0, from - page);
+    }
+    if (to < page + PAGE_BYTES) {
+      memset(host + (to - page), 0, page + PAGE_BYTES - to);
+    }
+    p.data = host;
+    p.fileBacked = true;
+  }
+  this->flushTlb();
+  return true;
 }
 
-bool MemoryManager::setShort(uint32_t addr, uint16_t val) {
-  if (!this->isAddrExist(addr)) {
-    dbgprintf("Short write to invalid addr 0x%x!\n", addr);
-    return false;
+bool MemoryManager::fill(uint64_t dest, uint8_t val, uint64_t len) {
+  while (len > 0) {
+    uint64_t offset = dest & (PAGE_BYTES - 1);
+    uint64_t chunk = std::min(len, PAGE_BYTES - offset);
+    uint8_t *page = val == 0 && this->findPage(dest) == nullptr
+                        ? nullptr
+                        : this->touchPage(dest);
+    if (page != nullptr) {
+      memset(page + offset, val, chunk);
+    }
+    dest += chunk;
+    len -= chunk;
   }
-  this->setByte(addr, val & 0xFF);
-  this->setByte(addr + 1, (val >> 8) & 0xFF);
   return true;
 }
 
-uint16_t MemoryManager::getShort(uint32_t addr) {
-  uint32_t b1 = this->getByte(addr);
-  uint32_t b2 = this->getByte(addr + 1);
-  return b1 + (b2 << 8);
+bool MemoryManager::setByte(uint64_t addr, uint8_t val) {
+  this->store(addr, val);
+  return true;
 }
 
-bool MemoryManager::setInt(uint32_t addr, uint32_t val) {
-  if (!this->isAddrExist(addr)) {
-    dbgprintf("Int write to invalid addr 0x%x!\n", addr);
-    return false;
-  }
-  this->setByte(addr, val & 0xFF);
-  this->setByte(addr + 1, (val >> 8) & 0xFF);
-  this->setByte(addr + 2, (val >> 16) & 0xFF);
-  this->setByte(addr + 3, (val >> 24) & 0xFF);
+uint8_t MemoryManager::getByte(uint64_t addr) {
+  return this->load<uint8_t>(addr);
+}
+
+bool MemoryManager::setShort(uint64_t addr, uint16_t val) {
+  this->store(addr, val);
   return true;
 }
 
-uint32_t MemoryManager::getInt(uint32_t addr) {
-  uint32_t b1 = this->getByte(addr);
-  uint32_t b2 = this->getByte(addr + 1);
-  uint32_t b3 = this->getByte(addr + 2);
-  uint32_t b4 = this->getByte(addr + 3);
-  return b1 + (b2 << 8) + (b3 << 16) + (b4 << 24);
+uint16_t MemoryManager::getShort(uint64_t addr) {
+  return this->load<uint16_t>(addr);
 }
 
-bool MemoryManager::setLong(uint32_t addr, uint64_t val) {
-  if (!this->isAddrExist(addr)) {
-    dbgprintf("Long write to invalid addr 0x%x!\n", addr);
-    return false;
-  }
-  this->setByte(addr, val & 0xFF);
-  this->setByte(addr + 1, (val >> 8) & 0xFF);
-  this->setByte(addr + 2, (val >> 16) & 0xFF);
-  this->setByte(addr + 3, (val >> 24) & 0xFF);
-  this->setByte(addr + 4, (val >> 32) & 0xFF);
-  this->setByte(addr + 5, (val >> 40) & 0xFF);
-  this->setByte(addr + 6, (val >> 48) & 0xFF);
-  this->setByte(addr + 7, (val >> 56) & 0xFF);
+bool MemoryManager::setInt(uint64_t addr, uint32_t val) {
+  this->store(addr, val);
   return true;
 }
 
-uint64_t MemoryManager::getLong(uint32_t addr) {
-  uint64_t b1 = this->getByte(addr);
-  uint64_t b2 = this->getByte(addr + 1);
-  uint64_t b3 = this->getByte(addr + 2);
-  uint64_t b4 = this->getByte(addr + 3);
-  uint64_t b5 = this->getByte(addr + 4);
-  uint64_t b6 = this->getByte(addr + 5);
-  uint64_t b7 = this->getByte(addr + 6);
-  uint64_t b8 = this->getByte(addr + 7);
-  return b1 + (b2 << 8) + (b3 << 16) + (b4 << 24) + (b5 << 32) + (b6 << 40) +
-         (b7 << 48) + (b8 << 56);
+uint32_t MemoryManager::getInt(uint64_t addr) {
+  return this->load<uint32_t>(addr);
 }
 
-bool MemoryManager::isAddrExist(uint32_t addr) {
-  if (addr >= MEMORYSIZE) return false;
+bool MemoryManager::setLong(uint64_t addr, uint64_t val) {
+  this->store(addr, val);
   return true;
 }
+
+uint64_t MemoryManager::getLong(uint64_t addr) {
+  return this->load<uint64_t>(addr);
+}
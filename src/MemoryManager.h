@@ -3,37 +3,112 @@
 
 #include <cstdint>
 #include <cstdio>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <elfio/elfio.hpp>
 
-#define MEMORYSIZE 104857600 // 100MB
-
 class Cache;
 
+// Guest memory is a sparse table of 4KB pages over the whole 64-bit
+// address space. A page is allocated, zero filled, on the first write to
+// it; reading a page that was never written returns zeroes.
+//
+// A direct mapped software TLB in front of the table caches the host page
+// of recently used guest pages, separately for reads (loads and fetch) and
+// writes. Pages never written are mapped read only to a shared zero page.
+//
+// snapshot() records the current contents as the image reset() goes back
+// to. From then on the first write to each page misses the write TLB, which
+// backs the page up and lists it as dirty, so reset() only touches the
+// pages written since and frees the ones allocated since.
 class MemoryManager
 {
 public:
+  static const int PAGE_BITS = 12;
+  static const uint64_t PAGE_BYTES = 1ull << PAGE_BITS;
+
   MemoryManager();
   ~MemoryManager();
 
-  bool copyFrom(const void *src, uint32_t dest, uint32_t len);
+  bool copyFrom(const void *src, uint64_t dest, uint64_t len);
+  // Maps len bytes of file fd at offset to dest copy on write, the pages
+  // stay shared with the page cache until written. Bytes of the first and
+  // last page outside the range read as zero. Returns false, mapping
+  // nothing, when dest and offset differ modulo the page size or mmap fails.
+  bool mapFile(int fd, uint64_t offset, uint64_t dest, uint64_t len);
+  // Sets len bytes from dest to val, filling with zero leaves pages that
+  // were never written unallocated
+  bool fill(uint64_t dest, uint8_t val, uint64_t len);
+
+  bool setByte(uint64_t addr, uint8_t val);
+  uint8_t getByte(uint64_t addr);
+
+  bool setShort(uint64_t addr, uint16_t val);
+  uint16_t getShort(uint64_t addr);
+
+  bool setInt(uint64_t addr, uint32_t val);
+  uint32_t getInt(uint64_t addr);
 
-  bool setByte(uint32_t addr, uint8_t val);
-  uint8_t getByte(uint32_t addr);
+  bool setLong(uint64_t addr, uint64_t val);
+  uint64_t getLong(uint64_t addr);
 
-  bool setShort(uint32_t addr, uint16_t val);
-  uint16_t getShort(uint32_t addr);
+  // Pages allocated so far
+  size_t pageCount() const { return this->pages.size(); }
+  // Drops every translation, needed whenever a page changes its host memory
+  void flushTlb();
 
-  bool setInt(uint32_t addr, uint32_t val);
-  uint32_t getInt(uint32_t addr);
+  // Takes the current contents as the image to reset to, usually right
+  // after loading the program. mapFile must not be used after it. Both
+  // clear tlbMisses, so it only counts the misses of the current run.
+  void snapshot();
+  // Restores the snapshot, returns the pages restored or freed
+  size_t reset();
+  size_t dirtyPageCount() const { return this->dirtyPages.size(); }
 
-  bool setLong(uint32_t addr, uint64_t val);
-  uint64_t getLong(uint32_t addr);
+  uint64_t tlbMisses = 0;
 
 private:
-  bool isAddrExist(uint32_t addr);
+  static const int TLB_BITS = 8;
+  static const uint64_t NO_PAGE = ~0ull; // never a page number
+
+  struct TlbEntry {
+    uint64_t readTag = NO_PAGE;  // page number readable through host
+    uint64_t writeTag = NO_PAGE; // page number writable through host
+    uint8_t *host = nullptr;
+  };
+
+  TlbEntry &tlbEntry(uint64_t pageNumber) {
+    return this->tlb[pageNumber & ((1 << TLB_BITS) - 1)];
+  }
+  // Slow paths on a TLB miss, they refill the entry
+  uint8_t *readPage(uint64_t addr);
+  uint8_t *writePage(uint64_t addr);
+
+  // Returns the page holding addr, nullptr if it was never written
+  uint8_t *findPage(uint64_t addr);
+  // Returns the page holding addr, allocating it on first use
+  uint8_t *touchPage(uint64_t addr);
+
+  // Little endian accesses of sizeof(T) bytes, one page lookup and one copy
+  // unless the access crosses into the next page
+  template <typename T> T load(uint64_t addr);
+  template <typename T> void store(uint64_t addr, T val);
+
+  struct Page {
+    uint8_t *data = nullptr;
+    bool fileBacked = false; // inside one of mappings, not allocated
+    bool inImage = false;    // existed when the snapshot was taken
+    bool dirty = false;      // written since the snapshot
+    uint8_t *backup = nullptr; // snapshot contents, once first written
+  };
 
-  uint8_t memory[MEMORYSIZE];
+  std::unordered_map<uint64_t, Page> pages; // page number -> data
+  std::vector<std::pair<void *, size_t>> mappings; // mmap address, length
+  bool tracking = false; // a snapshot was taken
+  std::vector<uint64_t> dirtyPages;
+  TlbEntry tlb[1 << TLB_BITS];
 };
 
-#endif
\ No newline at end of file
+#endif
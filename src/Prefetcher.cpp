@@ -0,0 +1,126 @@
+#include "Prefetcher.h"
+
+Prefetcher *Prefetcher::create(const std::string &name, int lineSize,
+                               int degree) {
+  if (name == "nextline") {
+    return new NextLinePrefetcher(lineSize, degree);
+  }
+  if (name == "stride") {
+    return new StridePrefetcher(lineSize, degree);
+  }
+  if (name == "stream") {
+    return new StreamPrefetcher(lineSize, degree);
+  }
+  return nullptr;
+}
+
+NextLinePrefetcher::NextLinePrefetcher(int lineSize, int degree)
+    : lineSize(lineSize), degree(degree) {}
+
+void NextLinePrefetcher::observe(uint64_t /*pc*/, uint64_t addr, bool trigger,
+                                 std::vector<uint64_t> &candidates) {
+  if (!trigger) {
+    return;
+  }
+  uint64_t line = addr & ~(uint64_t)(this->lineSize - 1);
+  for (int d = 1; d <= this->degree; ++d) {
+    candidates.push_back(line + (uint64_t)d * this->lineSize);
+  }
+}
+
+StridePrefetcher::StridePrefetcher(int lineSize, int degree, int tableBits)
+    : lineSize(lineSize), degree(degree), tableBits(tableBits),
+      table(1 << tableBits) {}
+
+void StridePrefetcher::observe(uint64_t pc, uint64_t addr, bool /*trigger*/,
+                               std::vector<uint64_t> &candidates) {
+  // every access trains the table, not just the misses
+  Entry &e = this->table[(pc >> 2) & ((1 << this->tableBits) - 1)];
+  if (e.pc != pc) {
+    e.pc = pc;
+    e.lastAddr = addr;
+    e.stride = 0;
+    e.confidence = 0;
+    return;
+  }
+  int64_t stride = (int64_t)(addr - e.lastAddr);
+  e.lastAddr = addr;
+  if (stride == 0) {
+    return;
+  }
+  if (stride == e.stride) {
+    if (e.confidence < 3) e.confidence++;
+  } else {
+    e.stride = stride;
+    e.confidence = 0;
+  }
+  if (e.confidence < 1) {
+    return;
+  }
+  // strides below a line would prefetch the same line again, step whole
+  // lines in the stride's direction instead
+  int64_t step = e.stride;
+  if (step > -this->lineSize && step < this->lineSize) {
+    step = step > 0 ? this->lineSize : -this->lineSize;
+  }
+  for (int d = 1; d <= this->degree; ++d) {
+    candidates.push_back(addr + step * d);
+  }
+}
+
+StreamPrefetcher::StreamPrefetcher(int lineSize, int degree, int numStreams)
+    : lineSize(lineSize), degree(degree), streams(numStreams) {}
+
+void StreamPrefetcher::observe(uint64_t /*pc*/, uint64_t addr, bool trigger,
+                               std::vector<uint64_t> &candidates) {
+  if (!trigger) {
+    return;
+  }
+  uint64_t line = addr / this->lineSize;
+  for (Stream &s : this->streams) {
+    if (!s.valid) {
+      continue;
+    }
+    if (s.direction == 0) {
+      // training, a miss to a neighbouring line confirms the stream
+      if (line != s.lastLine + 1 && line != s.lastLine - 1) {
+        continue;
+      }
+      s.direction = line > s.lastLine ? 1 : -1;
+      s.frontier = line;
+    } else {
+      // confirmed, accept triggers up to degree lines ahead of the last one
+      int64_t ahead = ((int64_t)line - (int64_t)s.lastLine) * s.direction;
+      if (ahead <= 0 || ahead > this->degree) {
+        continue;
+      }
+    }
+    s.lastLine = line;
+    s.lastUse = ++this->useClock;
+    uint64_t target = line + (int64_t)this->degree * s.direction;
+    while (s.frontier != target) {
+      s.frontier += s.direction;
+      if (((int64_t)s.frontier - (int64_t)line) * s.direction > 0) {
+        candidates.push_back(s.frontier * this->lineSize);
+      }
+    }
+    return;
+  }
+
+  // start training a new stream in the least recently used buffer
+  Stream *victim = &this->streams[0];
+  for (Stream &s : this->streams) {
+    if (!s.valid) {
+      victim = &s;
+      break;
+    }
+    if (s.lastUse < victim->lastUse) {
+      victim = &s;
+    }
+  }
+  victim->valid = true;
+  victim->direction = 0;
+  victim->lastLine = line;
+  victim->frontier = line;
+  victim->lastUse = ++this->useClock;
+}
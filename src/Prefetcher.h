@@ -0,0 +1,98 @@
+/*
+ * Hardware prefetchers attached to a Cache
+ *
+ * The cache calls observe() on every demand access, for a lower level those
+ * are the misses of the level above with the pc of the instruction behind
+ * them. It issues the returned line addresses as prefetches when it has a
+ * free MSHR, prefetched lines go into the cache itself.
+ */
+
+#ifndef PREFETCHER_H
+#define PREFETCHER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Prefetcher {
+public:
+  virtual ~Prefetcher() {}
+
+  // trigger is set for a miss and for the first hit on a prefetched line,
+  // candidates get the addresses of the lines to prefetch appended
+  virtual void observe(uint64_t pc, uint64_t addr, bool trigger,
+                       std::vector<uint64_t> &candidates) = 0;
+  virtual const char *name() const = 0;
+  // Accesses without an instruction behind them are not observed
+  virtual bool needsPc() const { return false; }
+
+  // Returns nullptr for "none" or an unknown name
+  static Prefetcher *create(const std::string &name, int lineSize, int degree);
+};
+
+// Fetches the next degree lines after every trigger
+class NextLinePrefetcher : public Prefetcher {
+public:
+  NextLinePrefetcher(int lineSize, int degree);
+
+  void observe(uint64_t pc, uint64_t addr, bool trigger,
+               std::vector<uint64_t> &candidates) override;
+  const char *name() const override { return "nextline"; }
+
+private:
+  int lineSize;
+  int degree;
+};
+
+// Reference prediction table indexed by pc, prefetches degree strides ahead
+// once the same stride was seen twice in a row
+class StridePrefetcher : public Prefetcher {
+public:
+  StridePrefetcher(int lineSize, int degree, int tableBits = 8);
+
+  void observe(uint64_t pc, uint64_t addr, bool trigger,
+               std::vector<uint64_t> &candidates) override;
+  const char *name() const override { return "stride"; }
+  bool needsPc() const override { return true; }
+
+private:
+  struct Entry {
+    uint64_t pc = 0;
+    uint64_t lastAddr = 0;
+    int64_t stride = 0;
+    uint8_t confidence = 0; // 2-bit
+  };
+
+  int lineSize;
+  int degree;
+  int tableBits;
+  std::vector<Entry> table;
+};
+
+// Stream buffers: two misses to neighbouring lines confirm a stream, later
+// misses inside its window run it degree lines ahead. The buffers only
+// track the streams, the lines themselves go into the cache.
+class StreamPrefetcher : public Prefetcher {
+public:
+  StreamPrefetcher(int lineSize, int degree, int numStreams = 8);
+
+  void observe(uint64_t pc, uint64_t addr, bool trigger,
+               std::vector<uint64_t> &candidates) override;
+  const char *name() const override { return "stream"; }
+
+private:
+  struct Stream {
+    bool valid = false;
+    int direction = 0;     // +1 or -1 once confirmed, 0 while training
+    uint64_t lastLine = 0; // line number of the newest trigger
+    uint64_t frontier = 0; // furthest line prefetched
+    uint64_t lastUse = 0;
+  };
+
+  int lineSize;
+  int degree;
+  uint64_t useClock = 0;
+  std::vector<Stream> streams;
+};
+
+#endif
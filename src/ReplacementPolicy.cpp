@@ -0,0 +1,143 @@
+#include "ReplacementPolicy.h"
+
+PackedArray::PackedArray(int bits, size_t count) {
+  this->bitShift = 0;
+  while ((1 << this->bitShift) < bits) {
+    this->bitShift++;
+  }
+  this->wordShift = 6 - this->bitShift;
+  this->mask = this->bitShift == 6 ? ~0ull : (1ull << (1 << this->bitShift)) - 1;
+  this->words.resize((count + (1 << this->wordShift) - 1) >> this->wordShift);
+}
+
+// bits to hold values 0..n-1
+static int bitsFor(int n) {
+  int bits = 1;
+  while ((1 << bits) < n) {
+    bits++;
+  }
+  return bits;
+}
+
+ReplacementPolicy *ReplacementPolicy::create(const std::string &name,
+                                             uint32_t numSets, int ways) {
+  if (name == "lru") {
+    return new LruPolicy(numSets, ways);
+  }
+  if (name == "plru") {
+    return new TreePlruPolicy(numSets, ways);
+  }
+  if (name == "random") {
+    return new RandomPolicy(ways);
+  }
+  if (name == "srrip") {
+    return new RripPolicy(numSets, ways, false);
+  }
+  if (name == "brrip") {
+    return new RripPolicy(numSets, ways, true);
+  }
+  return nullptr;
+}
+
+LruPolicy::LruPolicy(uint32_t numSets, int ways)
+    : ways(ways), ranks(bitsFor(ways), (size_t)numSets * ways) {
+  for (uint32_t set = 0; set < numSets; ++set) {
+    for (int w = 0; w < ways; ++w) {
+      this->ranks.set((size_t)set * ways + w, w);
+    }
+  }
+}
+
+void LruPolicy::touch(uint32_t set, int way) {
+  size_t base = (size_t)set * this->ways;
+  uint32_t rank = this->ranks.get(base + way);
+  for (int w = 0; w < this->ways; ++w) {
+    uint32_t r = this->ranks.get(base + w);
+    if (r < rank) {
+      this->ranks.set(base + w, r + 1);
+    }
+  }
+  this->ranks.set(base + way, 0);
+}
+
+int LruPolicy::victim(uint32_t set) {
+  size_t base = (size_t)set * this->ways;
+  for (int w = 0; w < this->ways; ++w) {
+    if (this->ranks.get(base + w) == (uint32_t)this->ways - 1) {
+      return w;
+    }
+  }
+  return 0;
+}
+
+TreePlruPolicy::TreePlruPolicy(uint32_t numSets, int ways)
+    : ways(ways), levels(bitsFor(ways)), bits(1, (size_t)numSets * ways) {
+  if (ways == 1) {
+    this->levels = 0;
+  }
+}
+
+// The tree of a set is stored heap style in bits 1..ways-1 of its ways
+// slots, node n has children 2n and 2n+1
+void TreePlruPolicy::touch(uint32_t set, int way) {
+  size_t base = (size_t)set * this->ways;
+  int node = 1;
+  for (int level = this->levels - 1; level >= 0; --level) {
+    int right = (way >> level) & 1;
+    // point away from the half just used
+    this->bits.set(base + node, !right);
+    node = node * 2 + right;
+  }
+}
+
+int TreePlruPolicy::victim(uint32_t set) {
+  size_t base = (size_t)set * this->ways;
+  int node = 1;
+  for (int level = 0; level < this->levels; ++level) {
+    node = node * 2 + this->bits.get(base + node);
+  }
+  return node - this->ways;
+}
+
+RandomPolicy::RandomPolicy(int ways) : ways(ways) {}
+
+int RandomPolicy::victim(uint32_t /*set*/) {
+  this->state ^= this->state << 13;
+  this->state ^= this->state >> 7;
+  this->state ^= this->state << 17;
+  return this->state % this->ways;
+}
+
+RripPolicy::RripPolicy(uint32_t numSets, int ways, bool bimodal)
+    : ways(ways), bimodal(bimodal), rrpv(2, (size_t)numSets * ways) {
+  for (size_t i = 0; i < (size_t)numSets * ways; ++i) {
+    this->rrpv.set(i, MAX_RRPV);
+  }
+}
+
+void RripPolicy::touch(uint32_t set, int way) {
+  this->rrpv.set((size_t)set * this->ways + way, 0);
+}
+
+void RripPolicy::insert(uint32_t set, int way) {
+  uint32_t value = MAX_RRPV - 1;
+  if (this->bimodal && ++this->fills % BIMODAL_PERIOD != 0) {
+    value = MAX_RRPV;
+  }
+  this->rrpv.set((size_t)set * this->ways + way, value);
+}
+
+int RripPolicy::victim(uint32_t set) {
+  size_t base = (size_t)set * this->ways;
+  while (true) {
+    for (int w = 0; w < this->ways; ++w) {
+      if (this->rrpv.get(base + w) == MAX_RRPV) {
+        return w;
+      }
+    }
+    // nobody is predicted distant, age the whole set
+    for (int w = 0; w < this->ways; ++w) {
+      this->rrpv.set(base + w, this->rrpv.get(base + w) + 1);
+    }
+  }
+}
@@ -0,0 +1,126 @@
+/*
+ * Cache replacement policies
+ *
+ * The cache fills invalid ways first and only asks the policy for a victim
+ * in a full set. The per way state of every policy is packed into 64-bit
+ * words, a 16-way LRU set takes one word instead of sixteen timestamps.
+ */
+
+#ifndef REPLACEMENT_POLICY_H
+#define REPLACEMENT_POLICY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Fixed width fields packed into 64-bit words, the width is rounded up to a
+// power of two so no field straddles two words
+class PackedArray {
+public:
+  PackedArray(int bits, size_t count);
+
+  uint32_t get(size_t i) const {
+    return (this->words[i >> this->wordShift] >> this->offset(i)) & this->mask;
+  }
+  void set(size_t i, uint32_t value) {
+    uint64_t &word = this->words[i >> this->wordShift];
+    word &= ~(this->mask << this->offset(i));
+    word |= (uint64_t)value << this->offset(i);
+  }
+
+private:
+  int offset(size_t i) const {
+    return (i & ((1 << this->wordShift) - 1)) << this->bitShift;
+  }
+
+  int bitShift;  // log2 of the field width
+  int wordShift; // log2 of the fields per word
+  uint64_t mask;
+  std::vector<uint64_t> words;
+};
+
+class ReplacementPolicy {
+public:
+  virtual ~ReplacementPolicy() {}
+
+  // A hit on way
+  virtual void touch(uint32_t set, int way) = 0;
+  // A new line filled into way
+  virtual void insert(uint32_t set, int way) = 0;
+  virtual int victim(uint32_t set) = 0;
+  virtual const char *name() const = 0;
+
+  // Returns nullptr for an unknown name
+  static ReplacementPolicy *create(const std::string &name, uint32_t numSets,
+                                   int ways);
+};
+
+// True LRU, every way keeps its recency rank, 0 being the most recent
+class LruPolicy : public ReplacementPolicy {
+public:
+  LruPolicy(uint32_t numSets, int ways);
+
+  void touch(uint32_t set, int way) override;
+  void insert(uint32_t set, int way) override { this->touch(set, way); }
+  int victim(uint32_t set) override;
+  const char *name() const override { return "lru"; }
+
+private:
+  int ways;
+  PackedArray ranks;
+};
+
+// Binary tree of ways - 1 bits per set, each pointing to the half that
+// was used less recently. Needs a power of two ways.
+class TreePlruPolicy : public ReplacementPolicy {
+public:
+  TreePlruPolicy(uint32_t numSets, int ways);
+
+  void touch(uint32_t set, int way) override;
+  void insert(uint32_t set, int way) override { this->touch(set, way); }
+  int victim(uint32_t set) override;
+  const char *name() const override { return "plru"; }
+
+private:
+  int ways;
+  int levels;
+  PackedArray bits;
+};
+
+class RandomPolicy : public ReplacementPolicy {
+public:
+  explicit RandomPolicy(int ways);
+
+  void touch(uint32_t /*set*/, int /*way*/) override {}
+  void insert(uint32_t /*set*/, int /*way*/) override {}
+  int victim(uint32_t set) override;
+  const char *name() const override { return "random"; }
+
+private:
+  int ways;
+  uint64_t state = 0x9E3779B97F4A7C15ull; // xorshift, fixed seed
+};
+
+// Re-reference interval prediction with 2-bit values per way. Static RRIP
+// inserts with a long interval, bimodal RRIP with a distant one except for
+// one fill in 32, which keeps thrashing working sets from flushing a cache.
+class RripPolicy : public ReplacementPolicy {
+public:
+  RripPolicy(uint32_t numSets, int ways, bool bimodal);
+
+  void touch(uint32_t set, int way) override;
+  void insert(uint32_t set, int way) override;
+  int victim(uint32_t set) override;
+  const char *name() const override { return this->bimodal ? "brrip" : "srrip"; }
+
+private:
+  static const uint32_t MAX_RRPV = 3;
+  static const int BIMODAL_PERIOD = 32;
+
+  int ways;
+  bool bimodal;
+  uint32_t fills = 0;
+  PackedArray rrpv;
+};
+
+#endif
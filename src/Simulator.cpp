@@ -4,8 +4,18 @@
 #include <string>
 
 #include "Simulator.h"
+#include "BranchPredictor.h"
+#include "BranchTarget.h"
+#include "Cache.h"
+#include "Dram.h"
 #include "riscv.h"
 #include "Debug.h"
+#include "Decoder.h"
+#include "FunctionUnitPool.h"
+#include "LoadStoreQueue.h"
+#include "StoreBuffer.h"
+#include "StoreSetPredictor.h"
+#include "StackDistance.h"
 #include "Tomasulo.h"
 
 namespace RISCV {
@@ -62,23 +72,52 @@ Simulator::Simulator(MemoryManager *memory) {
   for (int i = 0; i < REGNUM; ++i) {
     this->reg[i] = 0;
   }
-  this->tomasulo = new Tomasulo(5, 9, 32);
+  this->tomasulo = nullptr; // sized from config once options are parsed
+  this->isSingleStep = false;
+  this->verbose = false;
+  this->shouldDumpHistory = false;
+  this->stackBase = 0;
+  this->maximumStackSize = 0;
+  this->decode_op = this->execute_op = this->mem_op = this->wb_op = nullptr;
+  this->waitForBranch = false;
+  this->shouldRecoverBranch = false;
+  this->branchNextPC = 0;
+  this->recoverRobIndex = -1;
+  this->waitForData = false;
+  this->datahazard_execute_op_dest = -1;
+  this->datahazard_mem_op_dest = -1;
+  this->datahazard_wb_op_dest = -1;
+  this->history = History(); // value initialized, every counter zero
 }
 
-Simulator::~Simulator() {}
+Simulator::~Simulator() {
+  // the components main attached to this simulator
+  delete this->tomasulo;
+  delete this->branchPredictor;
+  delete this->btb;
+  delete this->ras;
+  delete this->fuPool;
+  delete this->lsq;
+  delete this->storeSets;
+  delete this->storeBuffer;
+  delete this->icache;
+  delete this->dcache;
+  delete this->l2cache;
+  delete this->dram;
+  delete this->instProfile;
+  delete this->dataProfile;
+}
 
-void Simulator::initStack(uint32_t baseaddr, uint32_t maxSize) {
+void Simulator::initStack(uint64_t baseaddr, uint64_t maxSize) {
+  // pages that were never written read as zero, no need to clear the stack
   this->reg[REG_SP] = baseaddr;
   this->stackBase = baseaddr;
   this->maximumStackSize = maxSize;
-  for (uint32_t addr = baseaddr; addr > baseaddr - maxSize; addr--) {
-    this->memory->setByte(addr, 0);
-  }
 }
 
 void Simulator::simulate() {
-  // Main Simulation Loop
-  int cnt = 0;
+  this->trace.open(this->traceFile);
+  // Main Simulation Loop, runs until an exit ecall
   while (true) {
     if (this->reg[0] != 0) {
       // Some instruction might set this register to zero
@@ -99,6 +138,9 @@ void Simulator::simulate() {
       this->branchNextPC = 0;
 
       this->waitForBranch = false;
+      this->fetchQueue.clear();
+      this->fetchBubble = 0;
+      this->fetchReadyCycle = 0;
     }
     // clean data hazard
     this->waitForData = false;
@@ -111,7 +153,11 @@ void Simulator::simulate() {
     this->commit();
     this->writeBack();
     this->execute();
+    if (this->exited) {
+      break; // exit ecall, the rest of the cycle never happens
+    }
     this->issue();
+    this->fetch();
 
     saveCycleData(history.cycleCount);
     this->history.cycleCount++;
@@ -134,63 +180,247 @@ void Simulator::simulate() {
         }
       }
     }
-    if (cnt++ > 20) break;
-    this->tomasulo->printROB();
-    this->tomasulo->printRS();
-    this->tomasulo->printRegisterStatus();
+    if (verbose) {
+      this->tomasulo->printROB();
+      this->tomasulo->printRS();
+      this->tomasulo->printRegisterStatus();
+    }
   }
-  saveSimulationData("simulation.json");
+  if (shouldDumpHistory) {
+    printf("Dumping history to dump.txt...");
+    this->dumpHistory();
+  }
+  this->printStatistics();
+  this->trace.close();
 }
 
 Instruction fetchInstruction(uint64_t inst);
 
-void Simulator::issue() {
+void Simulator::fetch() {
+    // Wait for the redirect of a resolving branch or an unknown jalr target
+    if (this->waitForBranch || this->shouldRecoverBranch) {
+      this->history.fetchRedirectStallCycles++;
+      return;
+    }
+    if (this->fetchBubble > 0) {
+      this->fetchBubble--;
+      this->history.fetchTakenBubbleCycles++;
+      return;
+    }
+    if (this->history.cycleCount < this->fetchReadyCycle) {
+      this->history.fetchICacheStallCycles++;
+      return;
+    }
 
-    uint64_t pc;
-    uint32_t inst;
+    // A fetch group never crosses an aligned fetch block
+    uint64_t blockEnd = (this->pc & ~(uint64_t)(config.fetchBlockBytes - 1)) +
+                        config.fetchBlockBytes;
+    for (int n = 0; n < config.fetchWidth; ++n) {
+      if ((int)this->fetchQueue.size() >= config.fetchQueueSize) {
+        if (n == 0) {
+          this->history.fetchQueueFullCycles++;
+        }
+        break;
+      }
+      if (this->pc >= blockEnd) {
+        break;
+      }
+      // The hit latency is part of the front end depth, a miss stalls fetch
+      // until the line arrives
+      if (n == 0 || this->pc % this->icache->lineSize() == 0) {
+        if (!this->icache->canAccept(this->pc, this->history.cycleCount)) {
+          if (n == 0) {
+            this->history.fetchICacheStallCycles++;
+          }
+          break;
+        }
+        uint32_t latency = this->icache->access(this->pc, false,
+                                                this->history.cycleCount, this->pc);
+        if (latency > this->icache->hitLatency()) {
+          this->fetchReadyCycle = this->history.cycleCount + latency - this->icache->hitLatency();
+          break;
+        }
+      }
 
-    pc = this->pc;
-    inst = memory->getInt(pc);
-    Instruction ins;
-    bool status = this->tomasulo->decode(inst, this->reg, &ins, this);
-    if (!status) {
-      dbgprintf("Error!");
-      panic("Error");
-    }
-
-    InstType instType = ins.opType;        // Example: "ADD", "LW", "SW"
-    int rd = ins.destReg;                        // Destination register
-    int rs = ins.srcReg1;                        // Source register 1
-    int rt = ins.srcReg2;                        // Source register 2 (if applicable)
-
-    // Check for branches or jumps (stall if needed)
-    for (auto& entry: tomasulo->rob) {
-      // if any jump or branch inst is in rob, do not issue new inst
-      if (isJump(entry.inst.opType) || isBranch(entry.inst.opType)) {
-        if (entry.busy) {
-          return; 
+      if (this->instProfile != nullptr) {
+        this->instProfile->access(this->pc);
+      }
+      FetchEntry entry;
+      entry.pc = this->pc;
+      entry.dec = this->decodeCache.lookup(this->pc, this);
+      entry.predictedPC = this->predictNextPC(entry);
+      this->fetchQueue.push_back(entry);
+      this->history.fetchedInstCount++;
+      this->pc = entry.predictedPC;
+
+      if (this->waitForBranch) {
+        break;
+      }
+      // Redirecting to a predicted target ends the group
+      if (entry.predictedPC != entry.pc + 4) {
+        this->fetchBubble = config.takenBranchBubble;
+        break;
+      }
+    }
+}
+
+uint64_t Simulator::predictNextPC(FetchEntry &entry) {
+    const DecodedInst &dec = entry.dec;
+    InstType instType = dec.opType;
+    uint64_t nextPC = entry.pc + 4;
+
+    if (instType == UNKNOWN) {
+      // Wrong path or past an exit ecall, issue decides once it gets here
+      entry.fetchWaits = true;
+    } else if (instType == JAL) {
+      nextPC = entry.pc + dec.offset; // target is in the predecoded bits
+    } else if (instType == JALR) {
+      // jalr x0, 0(ra) is a return, anything else goes through the BTB
+      uint64_t target = 0;
+      if (this->branchPredictor != nullptr && this->btb != nullptr) {
+        if (dec.destReg == REG_ZERO && dec.srcReg1 == REG_RA &&
+            this->ras->pop(&target)) {
+          entry.targetSource = TargetSource::RAS;
+        } else if (this->btb->lookup(entry.pc, &target)) {
+          entry.targetSource = TargetSource::BTB;
         }
       }
+      if (entry.targetSource == TargetSource::NONE) {
+        entry.fetchWaits = true; // target only known after execute
+      } else {
+        nextPC = target;
+      }
+    } else if (isBranch(instType)) {
+      if (this->branchPredictor == nullptr) {
+        entry.fetchWaits = true;
+      } else {
+        entry.branchHistory = this->branchPredictor->history();
+        if (this->branchPredictor->predict(entry.pc)) {
+          nextPC = entry.pc + dec.offset;
+        }
+      }
+    } else if (this->branchPredictor != nullptr) {
+      entry.branchHistory = this->branchPredictor->history();
     }
 
-    // Step 1: Allocate ROB Entry
-    int robIndex = tomasulo->allocateROBEntry(instType, rd);
-    if (robIndex == -1) {
-        return; // Stall if ROB is full
+    // Calls push their return address
+    if (isJump(instType) && dec.destReg == REG_RA && this->ras != nullptr) {
+      this->ras->push(entry.pc + 4);
+    }
+    if (this->ras != nullptr) {
+      entry.rasState = this->ras->snapshot();
+    }
+    if (entry.fetchWaits) {
+      this->waitForBranch = true;
+    }
+    return nextPC;
+}
+
+void Simulator::issue() {
+
+    // Whatever is queued behind a resolved misprediction is wrong path
+    int issued = 0;
+    bool backEndStall = false;
+    if (!this->shouldRecoverBranch) {
+      // Stops at the first instruction that cannot issue, the following ones
+      // must not overtake it
+      while (issued < config.issueWidth && this->issueOne(backEndStall)) {
+        issued++;
+      }
+      // Stall cycles are the ones that issued nothing at all
+      if (issued == 0 && this->fetchQueue.empty()) {
+        this->history.frontEndStallCycles++;
+      } else if (issued == 0 && backEndStall) {
+        this->history.backEndStallCycles++;
+      }
+    }
+    if (this->history.issueHistogram.size() < (size_t)config.issueWidth + 1) {
+      this->history.issueHistogram.resize(config.issueWidth + 1, 0);
+    }
+    this->history.issueHistogram[issued]++;
+}
+
+bool Simulator::issueOne(bool &backEndStall) {
+
+    if (this->fetchQueue.empty()) {
+        return false;
+    }
+
+    // Step 1: Check ROB Entry, it is only allocated once a RS entry is found
+    if (tomasulo->rob[tomasulo->robTail].busy) {
+        backEndStall = true;
+        return false; // Stall if ROB is full
+    }
+
+    // Static decode was done by fetch through the predecode cache, register
+    // values are resolved below through the register status table
+    const FetchEntry &fetched = this->fetchQueue.front();
+    const DecodedInst &dec = fetched.dec;
+
+    InstType instType = dec.opType;        // Example: "ADD", "LW", "SW"
+    int rd = dec.destReg;                        // Destination register
+    int rs = dec.srcReg1;                        // Source register 1
+    int rt = dec.srcReg2;                        // Source register 2 (if applicable)
+
+    if (instType == UNKNOWN) {
+      // Possibly fetched down a mispredicted path or past an exit ecall,
+      // it is only an error once everything older has retired
+      if (tomasulo->rob[tomasulo->robHead].busy) {
+        return false;
+      }
+      this->panic("Unknown instruction 0x%08x at pc 0x%lx\n", dec.inst, fetched.pc);
+    }
+
+    if (isMem(instType) && this->lsq->full()) {
+        this->lsq->fullStallCount++;
+        backEndStall = true;
+        return false;
     }
 
     // Step 2: Allocate RS Entry
-    int rsIndex = tomasulo->allocateRS(instType, robIndex, -1, -1);
+    int rsIndex = tomasulo->allocateRS(instType, tomasulo->robTail, -1, -1);
     if (rsIndex == -1) {
-        return; // Stall if RS is full
+        backEndStall = true;
+        return false; // Stall if RS is full
     }
+    int robIndex = tomasulo->allocateROBEntry(instType, rd);
 
     Tomasulo::ReservationStation& rsTableEntry = tomasulo->rs[rsIndex];
 
+    Instruction ins;
+    ins.pc = fetched.pc;
+    ins.issueCycle = this->history.cycleCount;
+    ins.inst = dec.inst;
+    ins.opType = instType;
+    ins.destReg = rd;
+    ins.srcReg1 = rs;
+    ins.srcReg2 = rt;
+    ins.op.offset = dec.offset;
+    ins.op.op1 = dec.op1;
+    ins.op.op2 = dec.op2;
     ins.state = InstructionState::ISSUE;
+    ins.predictedPC = fetched.predictedPC;
+    ins.targetSource = fetched.targetSource;
+    ins.rasState = fetched.rasState;
+    ins.branchHistory = fetched.branchHistory;
+    ins.fetchWaits = fetched.fetchWaits;
+    if (isMem(instType)) {
+        int lsqIndex = this->lsq->allocate(robIndex, instType, fetched.pc);
+        ins.lsqIndex = lsqIndex;
+        if (this->storeSets != nullptr) {
+            int storeIndex;
+            uint64_t storeSeq;
+            if (isWriteMem(instType)) {
+                this->storeSets->issueStore(fetched.pc, lsqIndex, this->lsq->seqOf(lsqIndex));
+            } else if (this->storeSets->dependence(fetched.pc, &storeIndex, &storeSeq)) {
+                this->lsq->setDependence(lsqIndex, storeIndex, storeSeq);
+            }
+        }
+    }
+    this->fetchQueue.pop_front();
 
-    // Step 3: Update RS[r] for rs and rt
-    if (isIType(instType) || isRType(instType) || isSType(instType) || isBType(instType)) { // If rs is a valid register
+    // Step 3: Update RS[r] for rs and rt, immediates go straight into vj/vk
+    if (dec.op1FromReg) { // If rs is a valid register
         if (tomasulo->registerStatus[rs].busy) {
             int robIndexSrc = tomasulo->registerStatus[rs].robIndex;
             Tomasulo::ROBEntry& robEntry = tomasulo->rob[robIndexSrc];
@@ -204,9 +434,11 @@ void Simulator::issue() {
             rsTableEntry.vj = reg[rs]; // Immediate value from register file
             rsTableEntry.qj = -1;     // Operand is ready
         }
+    } else {
+        rsTableEntry.vj = dec.op1;
     }
 
-    if (isRType(instType) || isSType(instType) || isBType(instType)) { // If rt is a valid register
+    if (dec.op2FromReg) { // If rt is a valid register
         Tomasulo::RegisterStatus& regStatusEntry = tomasulo->registerStatus[rt];
         if (regStatusEntry.busy) {
             int robIndexSrc = regStatusEntry.robIndex;
@@ -221,6 +453,8 @@ void Simulator::issue() {
             rsTableEntry.vk = reg[rt]; // Immediate value from register file
             rsTableEntry.qk = -1;     // Operand is ready
         }
+    } else {
+        rsTableEntry.vk = dec.op2;
     }
 
     // Step 4: Update RS Entry
@@ -229,65 +463,212 @@ void Simulator::issue() {
     rsTableEntry.op = instType;   // Instruction type
 
     // Step 5: Update ROB Entry
-    ins.opType = instType;
-    ins.remainingExecCycles = ins.remainingExecCycles;
     tomasulo->rob[robIndex].inst = ins;
     tomasulo->rob[robIndex].ready = false; // Set to true in WriteBack
 
     // step 7: store immdiate for load / store type
-    if (isReadMem(instType)) {
+    if (isMem(instType)) {
       rsTableEntry.addr = ins.op.offset;
     }
 
-    if (isWriteMem(instType)) {
-      rsTableEntry.addr = ins.op.offset;
-    }
-
-    // Step 6: if inst contains rd field, register it in register status
-    if (isIType(instType) || isRType(instType) || isUType(instType) || isJType(instType)) { // For instructions that have a destination register
+    // Step 6: if inst contains rd field, register it in register status.
+    // Younger instructions of the same issue group look it up from here on
+    if (rd != REG_ZERO) { // x0 is never renamed
         tomasulo->rob[robIndex].destination = rd;
         tomasulo->registerStatus[rd].robIndex = robIndex;
         tomasulo->registerStatus[rd].busy = true;
     }
 
-    pc += 4; // Move to the next instruction
+    // Step 8: speculating past a branch or a predicted jalr, keep the
+    // renaming to fall back to
+    if (isBranch(instType) || instType == JALR) {
+        tomasulo->takeCheckpoint(robIndex);
+    }
+    return true;
+}
+
+void Simulator::resolveControl(int robIndex) {
+    Instruction &inst = tomasulo->rob[robIndex].inst;
+    if (inst.fetchWaits) {
+      // fetch stopped behind this instruction, nothing younger to squash
+      this->history.fetchWaitCount++;
+      this->history.fetchWaitCycleCount += this->history.cycleCount - inst.issueCycle + 1;
+      this->pipeRecover(inst.nextPC, robIndex);
+      return;
+    }
+    if (inst.nextPC == inst.predictedPC) {
+      return;
+    }
+    // Wrong path, drop everything younger
+    this->history.controlHazardCount++;
+    // cycles issue spent on the wrong path plus the redirect bubble
+    this->history.recoveryCycleCount += this->history.cycleCount - inst.issueCycle + 1;
+    this->flushAfter(robIndex, inst.nextPC);
+}
+
+int Simulator::flushAfter(int robIndex, uint64_t restartPC) {
+    int squashed = tomasulo->squashAfter(robIndex);
+    this->lsq->squash([&](int r) { return !tomasulo->rob[r].busy; });
+    if (squashed > 0) {
+      this->history.squashCount++;
+      this->history.squashedInstCount += squashed;
+    }
+    // Undo the pushes and pops of the squashed calls and returns
+    const Instruction &inst = tomasulo->rob[robIndex].inst;
+    if (this->ras != nullptr) {
+      this->ras->restore(inst.rasState);
+    }
+    // Global history as it was right after fetching inst down the path
+    // fetch restarts on
+    if (this->branchPredictor != nullptr) {
+      GlobalHistory history = inst.branchHistory;
+      if (isBranch(inst.opType)) {
+        history.push(restartPC != inst.pc + 4);
+      }
+      this->branchPredictor->restore(history);
+    }
+    this->pipeRecover(restartPC, robIndex);
+    return squashed;
+}
+
+void Simulator::checkMemoryOrder(int storeIndex) {
+    int loadIndex = this->lsq->findViolation(storeIndex);
+    if (loadIndex < 0) {
+      return;
+    }
+    // A younger load already read stale bytes, replay from that load
+    this->history.memOrderViolationCount++;
+    if (this->storeSets != nullptr) {
+      this->storeSets->violation(this->lsq->pcOf(loadIndex), this->lsq->pcOf(storeIndex));
+    }
+    int loadRob = this->lsq->robIndexOf(loadIndex);
+    uint64_t loadPC = tomasulo->rob[loadRob].inst.pc;
+    this->history.replayCycleCount +=
+        this->history.cycleCount - tomasulo->rob[loadRob].inst.issueCycle + 1;
+    int robSize = tomasulo->rob.size();
+    int beforeLoad = (loadRob - 1 + robSize) % robSize; // the store at the latest
+    this->history.replayedInstCount += this->flushAfter(beforeLoad, loadPC);
+}
+
+bool Simulator::operandsReady(const Tomasulo::ReservationStation &rs, int robIndex) {
+    InstType type = tomasulo->rob[robIndex].inst.opType;
+    if (isReadMem(type)) {
+      if (rs.qj != -1) {
+        return false;
+      }
+      // disambiguate against the older stores in the load/store queue
+      int lsqIndex = tomasulo->rob[robIndex].inst.lsqIndex;
+      this->lsq->setAddress(lsqIndex, rs.addr + rs.vj);
+      LoadStoreQueue::LoadCheck check =
+          this->lsq->checkLoad(lsqIndex, this->storeSets != nullptr);
+      if (check == LoadStoreQueue::LoadCheck::BLOCKED_ADDR ||
+          check == LoadStoreQueue::LoadCheck::BLOCKED_DATA) {
+        this->lsq->noteBlocked(lsqIndex, check);
+        return false;
+      }
+      // a miss needs a free MSHR, loads to lines in flight merge
+      uint64_t addr = rs.addr + rs.vj;
+      if (check != LoadStoreQueue::LoadCheck::FORWARD &&
+          !this->storeBuffer->covers(addr, LoadStoreQueue::accessSize(type)) &&
+          !this->dcache->canAccept(addr, this->history.cycleCount)) {
+        return false;
+      }
+      return true;
+    }
+    if (isWriteMem(type)) {
+      // the data operand is only needed at write back
+      return rs.qj == -1;
+    }
+    // ecall has side effects, only run it once it is no longer speculative
+    if (type == ECALL && robIndex != tomasulo->robHead) {
+      return false;
+    }
+    return rs.qj == -1 && rs.qk == -1;
 }
 
 void Simulator::execute() {
-   for (size_t i = 0; i < tomasulo->rs.size(); ++i) {
-        Tomasulo::ReservationStation &currentRS = tomasulo->rs[i];
+    // Oldest instructions get the functional units first, walking the ROB
+    // from its head is already age order
+    int robSize = tomasulo->rob.size();
+    this->rsByRob.assign(robSize, -1);
+    for (size_t i = 0; i < tomasulo->rs.size(); ++i) {
+      if (tomasulo->rs[i].busy) {
+        this->rsByRob[tomasulo->rs[i].dest] = i;
+      }
+    }
 
-        // Skip entries that are not busy or already executing
+    for (int k = 0; k < robSize && !this->exited; ++k) {
+        int i = this->rsByRob[(tomasulo->robHead + k) % robSize];
+        if (i == -1) continue;
+        Tomasulo::ReservationStation &currentRS = tomasulo->rs[i];
+        // an older control instruction may have squashed this one already
         if (!currentRS.busy) continue;
         int robIndex = currentRS.dest;
         Tomasulo::ROBEntry& robEntry = tomasulo->rob[robIndex];
-        // Check if both operands are ready
-        if (robEntry.inst.state == InstructionState::ISSUE) {
-          // For simplicty, do not consider multiple ALUs or MULs
-          robEntry.inst.state = InstructionState::EXECUTE;
+        Instruction &inst = robEntry.inst;
+
+        if (inst.state == InstructionState::ISSUE) {
+          inst.state = InstructionState::READ_OPERANDS;
         }
 
-        if (robEntry.inst.state == InstructionState::EXECUTE) {
-          if (robEntry.inst.remainingExecCycles == 0) {
-            if (isReadMem(robEntry.inst.opType)) {
-              // check is any store ahead
-              if (!tomasulo->hasStoreConflict(robIndex)) {
-                robEntry.inst.state = InstructionState::WRITE_BACK;
-                tomasulo->execMem(&robEntry.inst, this);
-                robEntry.value = robEntry.inst.op.out;
-              }
-            } else if (isWriteMem(robEntry.inst.opType)) {
-                if (currentRS.qj == -1) {
-                  robEntry.inst.state = InstructionState::WRITE_BACK;
-                  robEntry.addr = currentRS.addr + currentRS.vj;
-                }
+        // Start once the operands are there and a unit is free
+        if (inst.state == InstructionState::READ_OPERANDS) {
+          if (!this->operandsReady(currentRS, robIndex)) {
+            continue;
+          }
+          int latency = config.opLatency[inst.opType];
+          if (!this->fuPool->acquire(instInfo(inst.opType).fu, latency,
+                                     this->history.cycleCount,
+                                     &inst.processingUnit)) {
+            continue; // structural hazard
+          }
+          inst.state = InstructionState::EXECUTE;
+          inst.remainingExecCycles = latency - 1;
+          if (isReadMem(inst.opType)) {
+            LoadStoreQueue::LoadCheck check =
+                this->lsq->checkLoad(inst.lsqIndex, this->storeSets != nullptr);
+            this->lsq->noteExecuted(check);
+            this->lsq->markExecuted(inst.lsqIndex);
+            // loads served entirely by older stores, in flight or
+            // committed, skip the cache
+            uint64_t addr = currentRS.addr + currentRS.vj;
+            if (check == LoadStoreQueue::LoadCheck::FORWARD) {
+            } else if (this->storeBuffer->covers(
+                           addr, LoadStoreQueue::accessSize(inst.opType))) {
+              this->storeBuffer->forwards++;
             } else {
-              if (currentRS.qj == -1 && currentRS.qk == -1) {
-                robEntry.inst.state = InstructionState::WRITE_BACK;
-                tomasulo->execArthimetic(&robEntry.inst, this);
-                robEntry.value = robEntry.inst.op.out;
-              }
+              inst.remainingExecCycles += this->dcache->access(
+                  addr, false, this->history.cycleCount, inst.pc);
             }
+            this->history.loadLatencySum += inst.remainingExecCycles + 1;
+          }
+        }
+
+        if (inst.state != InstructionState::EXECUTE) {
+          continue;
+        }
+        if (inst.remainingExecCycles > 0) {
+          inst.remainingExecCycles--;
+          continue;
+        }
+
+        // Last execute cycle, produce the result
+        inst.state = InstructionState::WRITE_BACK;
+        inst.op.op1 = currentRS.vj;
+        if (isReadMem(inst.opType)) {
+          tomasulo->execMem(&inst, this);
+          inst.op.out = this->lsq->forwardLoad(inst.lsqIndex, inst.op.out);
+          robEntry.value = inst.op.out;
+        } else if (isWriteMem(inst.opType)) {
+          robEntry.addr = currentRS.addr + currentRS.vj;
+          this->lsq->setAddress(inst.lsqIndex, robEntry.addr);
+          this->checkMemoryOrder(inst.lsqIndex);
+        } else {
+          inst.op.op2 = currentRS.vk;
+          tomasulo->execArthimetic(&inst, this);
+          robEntry.value = inst.op.out;
+          if (isControl(inst.opType)) {
+            this->resolveControl(robIndex);
           }
         }
     }
@@ -308,7 +689,15 @@ void Simulator::writeBack() {
     Tomasulo::ROBEntry &robEntry = tomasulo->rob[robIndex];
 
     if (isWriteMem(robEntry.inst.opType)) {
-      robEntry.value = currentRS.vk;
+      // A store is done once both its address and its data are known
+      if (robEntry.inst.state == InstructionState::WRITE_BACK &&
+          currentRS.qk == -1) {
+        robEntry.value = currentRS.vk;
+        robEntry.inst.op.op2 = currentRS.vk;
+        this->lsq->setStoreData(robEntry.inst.lsqIndex, currentRS.vk);
+        robEntry.ready = true;
+        currentRS.busy = false;
+      }
       continue;
     }
 
@@ -316,6 +705,7 @@ void Simulator::writeBack() {
     if (robEntry.inst.state == InstructionState::WRITE_BACK) {
       // Clear the Reservation Station
       currentRS.busy = false;
+      robEntry.ready = true;
 
       // Forward the result to other instructions waiting on it
       for (auto &rs : tomasulo->rs) {
@@ -333,49 +723,122 @@ void Simulator::writeBack() {
 }
 
 void Simulator::commit() {
+    // The store buffer drains before this cycle's stores enter it
+    this->storeBuffer->drain(this->dcache, this->history.cycleCount);
+
+    // Retire consecutive ready entries from the ROB head, in order
+    int retired = 0;
+    int storePorts = config.storeCommitPorts;
+    while (retired < config.commitWidth && this->commitOne(storePorts)) {
+        retired++;
+    }
+    if (this->history.commitHistogram.size() < (size_t)config.commitWidth + 1) {
+        this->history.commitHistogram.resize(config.commitWidth + 1, 0);
+    }
+    this->history.commitHistogram[retired]++;
+    this->storeBuffer->sample();
+}
+
+bool Simulator::commitOne(int &storePorts) {
    // Check the instruction at the head of the ROB
     Tomasulo::ROBEntry &headROB = tomasulo->rob[tomasulo->robHead];
 
     // If the head entry is not busy or not ready, stall commit
     if (!headROB.busy || !headROB.ready) {
-        return;
+        return false;
+    }
+
+    // Stores write memory at commit, compete for the store ports and need
+    // room in the store buffer
+    if (isWriteMem(headROB.inst.opType)) {
+        if (storePorts == 0) {
+            this->history.storePortStallCount++;
+            return false;
+        }
+        int size = LoadStoreQueue::accessSize(headROB.inst.opType);
+        if (!this->storeBuffer->canInsert(headROB.addr, size)) {
+            this->storeBuffer->fullStalls++;
+            return false;
+        }
+        storePorts--;
     }
 
     // Handle commit based on the instruction type
     if (isWriteMem(headROB.inst.opType)) {
-        tomasulo->execMem(&headROB.inst, this);
         // For Store, write the value to memory
+        tomasulo->execMem(&headROB.inst, this);
+        this->storeBuffer->insert(headROB.addr, headROB.inst.op.memLen,
+                                  headROB.inst.pc);
+        this->decodeCache.invalidate(headROB.addr, headROB.inst.op.memLen);
     } else {
         // For other instructions, write the result to the register file
         int destReg = headROB.destination;
-        if (destReg >= 0 && destReg < 32) {
+        if (destReg > 0 && destReg < 32) {
             reg[destReg] = headROB.value;
+            // Clear the Register Status Table if this ROB entry is the current register dependency
+            if (tomasulo->registerStatus[destReg].robIndex == tomasulo->robHead) {
+                tomasulo->registerStatus[destReg].busy = false;
+                tomasulo->registerStatus[destReg].robIndex = -1;
+            }
         }
-        // Clear the Register Status Table if this ROB entry is the current register dependency
-        if (tomasulo->registerStatus[destReg].robIndex == tomasulo->robHead) {
-            tomasulo->registerStatus[destReg].busy = false;
-            tomasulo->registerStatus[destReg].robIndex = -1;
+    }
+
+    // Train the predictor on the correct path only
+    if (isBranch(headROB.inst.opType)) {
+        this->history.branchCount++;
+        if (!headROB.inst.fetchWaits &&
+            headROB.inst.predictedPC != headROB.inst.nextPC) {
+            this->history.branchMispredictCount++;
         }
+        if (this->branchPredictor != nullptr) {
+            this->branchPredictor->update(headROB.inst.pc, headROB.inst.op.branch,
+                                          headROB.inst.branchHistory);
+        }
+    } else if (headROB.inst.opType == JALR) {
+        const Instruction &ins = headROB.inst;
+        bool correct = ins.predictedPC == ins.nextPC;
+        this->history.jumpCount++;
+        if (ins.targetSource == TargetSource::RAS) {
+            this->history.returnCount++;
+            this->history.rasCorrectCount += correct;
+        } else if (this->btb != nullptr && this->branchPredictor != nullptr) {
+            this->history.btbLookupCount++;
+            if (ins.targetSource == TargetSource::BTB) {
+                this->history.btbHitCount++;
+                this->history.btbCorrectCount += correct;
+            }
+        }
+        if (this->btb != nullptr) {
+            this->btb->update(ins.pc, ins.nextPC);
+        }
+    }
+
+    if (isMem(headROB.inst.opType)) {
+        this->lsq->release(headROB.inst.lsqIndex);
     }
 
     // Mark the ROB entry as no longer busy
+    tomasulo->releaseCheckpoint(tomasulo->robHead);
     headROB.busy = false;
+    this->history.instCount++;
 
     // Advance the ROB head pointer (circular buffer logic)
     tomasulo->robHead = (tomasulo->robHead + 1) % tomasulo->rob.size();
+    return true;
 }
 
-void Simulator::pipeRecover(uint32_t destPC) {
-  /* if there is already a recovery scheduled, it must have come from a later
-   * stage (which executes older instructions), hence that recovery overrides
-   * our recovery. Simply return in this case. */
-  if (this->shouldRecoverBranch)
+void Simulator::pipeRecover(uint64_t destPC, int robIndex) {
+  /* if there is already a recovery scheduled, keep the one coming from the
+   * older instruction, the younger one has been squashed by it anyway. */
+  if (this->shouldRecoverBranch &&
+      !this->tomasulo->isOlder(robIndex, this->recoverRobIndex))
     return;
 
   /* schedule the recovery. This will be done once all pipeline stages simulate
    * the current cycle. */
   this->shouldRecoverBranch = 1;
   this->branchNextPC = destPC;
+  this->recoverRobIndex = robIndex;
 }
 
 int64_t Simulator::handleSystemCall(int64_t op1, int64_t op2) {
@@ -383,7 +846,7 @@ int64_t Simulator::handleSystemCall(int64_t op1, int64_t op2) {
   int64_t arg1 = op1; // reg a0
   switch (type) {
   case 0: { // print string
-    uint32_t addr = arg1;
+    uint64_t addr = arg1;
     char ch = this->memory->getByte(addr);
     while (ch != '\0') {
       printf("%c", ch);
@@ -400,12 +863,8 @@ int64_t Simulator::handleSystemCall(int64_t op1, int64_t op2) {
   case 3:
   case 93: // exit
     printf("Program exit from an exit() system call\n");
-    if (shouldDumpHistory) {
-      printf("Dumping history to dump.txt...");
-      this->dumpHistory();
-    }
-    this->printStatistics();
-    exit(0);
+    this->exited = true;
+    break;
   case 4: // read char
     scanf(" %c", (char *)&op1);
     break;
@@ -429,14 +888,122 @@ void Simulator::printInfo() {
   printf("-----------------------------------\n");
 }
 
+// Percentages are of the sampled cycles, an exit ecall ends the run part
+// way through its last cycle
+static void printHistogram(const char *title,
+                           const std::vector<uint32_t> &histogram) {
+  uint64_t total = 0;
+  for (uint32_t count : histogram) {
+    total += count;
+  }
+  printf("%s:", title);
+  for (size_t i = 0; i < histogram.size(); ++i) {
+    printf(" %zu:%u(%.1f%%)", i, histogram[i], 100.0 * histogram[i] / total);
+  }
+  printf("\n");
+}
+
 void Simulator::printStatistics() {
   printf("------------ STATISTICS -----------\n");
   printf("Number of Instructions: %u\n", this->history.instCount);
   printf("Number of Cycles: %u\n", this->history.cycleCount);
   printf("Avg Cycles per Instrcution: %.4f\n",
          (float)this->history.cycleCount / this->history.instCount);
+  printf("Fetched Instructions: %u, Fetch Queue Full Cycles: %u\n",
+         this->history.fetchedInstCount, this->history.fetchQueueFullCycles);
+  printf("Fetch Stalls: %u redirect, %u taken branch bubble, %u icache miss\n",
+         this->history.fetchRedirectStallCycles,
+         this->history.fetchTakenBubbleCycles,
+         this->history.fetchICacheStallCycles);
+  printf("Issue Stalls: %u front end (queue empty), %u back end (ROB/RS/LSQ full)\n",
+         this->history.frontEndStallCycles, this->history.backEndStallCycles);
+  printHistogram("Issued per Cycle", this->history.issueHistogram);
+  printHistogram("Retired per Cycle", this->history.commitHistogram);
+  printf("Store Commit Port Stalls: %u\n", this->history.storePortStallCount);
+  for (int t = 1; t < FU_TYPE_COUNT; ++t) {
+    FunctionUnitType type = (FunctionUnitType)t;
+    int units = this->fuPool->count(type);
+    printf("FU %-6s x%d %-9s ops: %lu, utilization: %.2f%%, structural stalls: %lu\n",
+           FU_NAME[t], units,
+           this->fuPool->isPipelined(type) ? "pipelined" : "blocking",
+           this->fuPool->ops[t],
+           100.0 * this->fuPool->busyCycles[t] / ((uint64_t)units * this->history.cycleCount),
+           this->fuPool->structuralStalls[t]);
+  }
+  printf("Loads: %lu, Forwarded: %lu, Partially Forwarded: %lu, Avg Latency: %.2f\n",
+         this->lsq->loadCount, this->lsq->forwardCount,
+         this->lsq->partialForwardCount,
+         this->lsq->loadCount > 0
+             ? (double)this->history.loadLatencySum / this->lsq->loadCount
+             : 0.0);
+  printf("Blocked Loads: %lu (%lu cycles on store addresses, %lu on store data), "
+         "LSQ Full Stalls: %lu\n",
+         this->lsq->blockedLoadCount, this->lsq->blockedAddrCycles,
+         this->lsq->blockedDataCycles, this->lsq->fullStallCount);
+  printf("Memory Dependence: %s, Speculative Loads: %lu, Predicted Waits: %lu cycles\n",
+         this->storeSets != nullptr ? "store sets" : "conservative",
+         this->lsq->speculativeLoadCount, this->lsq->predictedWaitCycles);
+  if (this->lsq->speculativeLoadCount > 0) {
+    printf("Ordering Violations: %u (%.2f%% of speculative loads), "
+           "Replayed Instructions: %u, Replay Cycles: %u\n",
+           this->history.memOrderViolationCount,
+           100.0 * this->history.memOrderViolationCount / this->lsq->speculativeLoadCount,
+           this->history.replayedInstCount, this->history.replayCycleCount);
+  }
+  this->storeBuffer->printStatistics();
+  this->icache->printStatistics();
+  this->dcache->printStatistics();
+  this->l2cache->printStatistics();
+  if (this->dram != nullptr) {
+    this->dram->printStatistics();
+  }
+  printf("Guest Memory: %zu pages (%zuKB), dirty since load: %zu, "
+         "software TLB misses: %lu\n",
+         this->memory->pageCount(),
+         this->memory->pageCount() * MemoryManager::PAGE_BYTES / 1024,
+         this->memory->dirtyPageCount(), this->memory->tlbMisses);
+  if (this->instProfile != nullptr) {
+    this->instProfile->printStatistics();
+    this->dataProfile->printStatistics();
+  }
   printf("Number of Control Hazards: %u\n", this->history.controlHazardCount);
+  if (this->history.fetchWaitCount > 0) {
+    printf("Fetch Waits on Control: %u, Stall Cycles: %u\n",
+           this->history.fetchWaitCount, this->history.fetchWaitCycleCount);
+  }
+  if (this->history.branchCount > 0 && this->branchPredictor == nullptr) {
+    printf("Branch Predictor: none (stall), Branches: %u\n",
+           this->history.branchCount);
+  } else if (this->history.branchCount > 0) {
+    printf("Branch Predictor: %s\n", this->branchPredictor->name());
+    printf("Branches: %u, Mispredicted: %u, Accuracy: %.2f%%, MPKI: %.3f\n",
+           this->history.branchCount, this->history.branchMispredictCount,
+           100.0 * (this->history.branchCount - this->history.branchMispredictCount) /
+               this->history.branchCount,
+           1000.0 * this->history.branchMispredictCount / this->history.instCount);
+  }
+  if (this->history.jumpCount > 0) {
+    printf("Indirect Jumps: %u\n", this->history.jumpCount);
+    if (this->history.btbLookupCount > 0) {
+      printf("BTB Lookups: %u, Hits: %u (%.2f%%), Correct Targets: %u (%.2f%%)\n",
+             this->history.btbLookupCount, this->history.btbHitCount,
+             100.0 * this->history.btbHitCount / this->history.btbLookupCount,
+             this->history.btbCorrectCount,
+             100.0 * this->history.btbCorrectCount / this->history.btbLookupCount);
+    }
+    if (this->history.returnCount > 0) {
+      printf("RAS Predictions: %u, Correct: %u (%.2f%%)\n",
+             this->history.returnCount, this->history.rasCorrectCount,
+             100.0 * this->history.rasCorrectCount / this->history.returnCount);
+    }
+  }
+  printf("Squashes: %u, Squashed Instructions: %u, Recovery Cycles: %u\n",
+         this->history.squashCount, this->history.squashedInstCount,
+         this->history.recoveryCycleCount);
   printf("Number of Data Hazards: %u\n", this->history.dataHazardCount);
+  printf("Decode Cache Hits/Misses: %lu/%lu (%lu invalidations)\n",
+         this->decodeCache.hits, this->decodeCache.misses,
+         this->decodeCache.invalidations);
   printf("-----------------------------------\n");
 }
 
@@ -475,7 +1042,7 @@ void Simulator::dumpHistory() {
 }
 
 void Simulator::panic(const char *format, ...) {
-  saveSimulationData("simulation.json");
+  this->trace.close();
   char buf[BUFSIZ];
   va_list args;
   va_start(args, format);
@@ -487,81 +1054,6 @@ void Simulator::panic(const char *format, ...) {
   exit(-1);
 }
 
-using json = nlohmann::json;
-
-// Convert Instruction to JSON
-void to_json(json& j, const Instruction& inst) {
-    j = json{
-        {"pc", inst.pc},
-        {"destReg", inst.destReg},
-        {"srcReg1", inst.srcReg1},
-        {"srcReg2", inst.srcReg2},
-        {"state", static_cast<int>(inst.state)},
-        {"remainingExecCycles", inst.remainingExecCycles},
-        {"opType", static_cast<int>(inst.opType)},
-        {"inst", inst.inst},
-        {"processingUnit", inst.processingUnit},
-        {"instStr", inst.instStr}
-    };
-}
-
-// Convert ROBEntry to JSON
-void to_json(json& j, const Tomasulo::ROBEntry& entry) {
-    j = json{
-        {"destination", entry.destination},
-        {"value", entry.value},
-        {"ready", entry.ready},
-        {"busy", entry.busy},
-        {"addr", entry.addr},
-        {"inst", entry.inst}
-    };
-}
-
-// Convert ReservationStation to JSON
-void to_json(json& j, const Tomasulo::ReservationStation& rs) {
-    j = json{
-        {"op", static_cast<int>(rs.op)},
-        {"vj", rs.vj},
-        {"vk", rs.vk},
-        {"qj", rs.qj},
-        {"qk", rs.qk},
-        {"dest", rs.dest},
-        {"busy", rs.busy},
-        {"addr", rs.addr}
-    };
-}
-
-// Convert RegisterStatus to JSON
-void to_json(json& j, const Tomasulo::RegisterStatus& rs) {
-    j = json{
-        {"robIndex", rs.robIndex},
-        {"busy", rs.busy}
-    };
-}
-
-void Simulator::saveCycleData(int currentCycle) {
-  json cycleJson;
-  // Add current cycle number
-  cycleJson["cycle"] = currentCycle;
-  // Serialize ROB
-  cycleJson["rob"] = tomasulo->rob;
-  // Serialize Reservation Stations
-  cycleJson["rs"] = tomasulo->rs;
-  // Serialize Register Status
-  cycleJson["registerStatus"] = tomasulo->registerStatus;
-  // Add register values
-  cycleJson["reg"] = std::vector<uint64_t>(std::begin(reg), std::end(reg));
-  // Append to simulationData
-  simulationData["cycles"].push_back(cycleJson);
-}
-
-void Simulator::saveSimulationData(const std::string& filename) const {
-    std::ofstream file(filename);
-    if (file.is_open()) {
-        file << simulationData.dump(4); // Pretty-print with 4-space indentation
-        file.close();
-        std::cout << "Simulation data saved to " << filename << std::endl;
-    } else {
-        std::cerr << "Failed to open file: " << filename << std::endl;
-    }
+void Simulator::saveCycleData(uint64_t currentCycle) {
+  this->trace.writeCycle(currentCycle, *this->tomasulo, this->reg, RISCV::REGNUM);
 }
@@ -3,33 +3,61 @@
 
 #include <cstdarg>
 #include <cstdint>
+#include <deque>
 #include <ratio>
 #include <string>
 #include <vector>
 
+#include "BranchTarget.h"
+#include "Config.h"
+#include "DecodeCache.h"
 #include "MemoryManager.h"
 #include "Tomasulo.h"
+#include "TraceWriter.h"
 #include "riscv.h"
-#include <nlohmann/json.hpp>
 
+class BranchPredictor;
+class Cache;
+class Dram;
+class FunctionUnitPool;
+class LoadStoreQueue;
+class StoreBuffer;
+class StoreSetPredictor;
 class Scoreboard;
+class StackDistanceProfiler;
+
+// An instruction waiting in the fetch queue together with the next pc
+// fetch predicted for it
+struct FetchEntry {
+  uint64_t pc = 0;
+  DecodedInst dec;
+  uint64_t predictedPC = 0;
+  TargetSource targetSource = TargetSource::NONE;
+  ReturnAddressStack::Snapshot rasState;
+  GlobalHistory branchHistory; // speculative history before its prediction
+  bool fetchWaits = false; // fetch stopped until this resolves
+};
 
 class Simulator {
 public:
   bool isSingleStep;
   bool verbose;
   bool shouldDumpHistory;
+  bool exited = false; // the program made an exit ecall
   uint64_t pc;
   uint64_t reg[RISCV::REGNUM];
-  uint32_t stackBase;
-  uint32_t maximumStackSize;
+  uint64_t stackBase;
+  uint64_t maximumStackSize;
   MemoryManager *memory;
   Tomasulo* tomasulo;
+  std::vector<int> rsByRob; // execute's RS index of each ROB entry, -1 none
+  DecodeCache decodeCache;
+  SimConfig config;
 
   Simulator(MemoryManager *memory);
   ~Simulator();
 
-  void initStack(uint32_t baseaddr, uint32_t maxSize);
+  void initStack(uint64_t baseaddr, uint64_t maxSize);
 
   void simulate();
 
@@ -42,8 +70,25 @@ public:
   Pipe_Op *decode_op, *execute_op, *mem_op, *wb_op;
   // control hazard
   bool waitForBranch; // signal for fetch stage to stall, and need to turn to false when shouldRecoverBranch
+  std::deque<FetchEntry> fetchQueue;
+  int fetchBubble = 0; // cycles left before fetch follows a taken branch
+  uint64_t fetchReadyCycle = 0; // fetch waits for an icache fill until then
   bool shouldRecoverBranch;
   int64_t branchNextPC; 
+  int recoverRobIndex; // ROB index of the instruction that scheduled the recovery
+  BranchPredictor *branchPredictor = nullptr; // nullptr stalls issue on every branch
+  BranchTargetBuffer *btb = nullptr;          // jalr targets, nullptr waits for execute
+  ReturnAddressStack *ras = nullptr;
+  FunctionUnitPool *fuPool = nullptr;
+  LoadStoreQueue *lsq = nullptr;
+  StoreSetPredictor *storeSets = nullptr; // nullptr waits for all older stores
+  StoreBuffer *storeBuffer = nullptr;
+  Cache *icache = nullptr;
+  Cache *dcache = nullptr;
+  Cache *l2cache = nullptr;
+  Dram *dram = nullptr; // nullptr with fixed latency memory
+  StackDistanceProfiler *instProfile = nullptr; // fetch address stream
+  StackDistanceProfiler *dataProfile = nullptr; // execMem address stream
   // data hazard
   bool waitForData; // only when no waitForBranch will set, and every cycle to detect
   RISCV::RegId datahazard_execute_op_dest;
@@ -58,27 +103,66 @@ public:
     uint32_t controlHazardCount;
     uint32_t memoryHazardCount;
 
+    uint32_t branchCount;
+    uint32_t branchMispredictCount;
+    uint32_t squashCount;
+    uint32_t squashedInstCount;
+    uint32_t recoveryCycleCount;
+    uint32_t fetchWaitCount;      // control insts fetch stopped behind
+    uint32_t fetchWaitCycleCount; // cycles from their issue to resolution
+
+    uint32_t fetchedInstCount;
+    uint32_t fetchQueueFullCycles;
+    uint32_t fetchTakenBubbleCycles;
+    uint32_t fetchRedirectStallCycles;
+    uint32_t fetchICacheStallCycles;
+    uint32_t frontEndStallCycles; // nothing issued, the fetch queue was empty
+    uint32_t backEndStallCycles;  // nothing issued, a full ROB, RS or LSQ
+    std::vector<uint32_t> issueHistogram; // cycles by instructions issued
+    std::vector<uint32_t> commitHistogram; // cycles by instructions retired
+    uint32_t storePortStallCount; // commit stopped at a store, no port left
+
+    uint64_t loadLatencySum; // execute cycles of all loads
+    uint32_t memOrderViolationCount;
+    uint32_t replayedInstCount;
+    uint32_t replayCycleCount;
+
+    uint32_t jumpCount; // jalr only, jal targets are known at issue
+    uint32_t btbLookupCount;
+    uint32_t btbHitCount;
+    uint32_t btbCorrectCount;
+    uint32_t returnCount;
+    uint32_t rasCorrectCount;
+
     std::vector<std::string> instRecord;
     std::vector<std::string> regRecord;
   } history;
 
   void fetch();
-  void decode();
   void execute();
+  bool operandsReady(const Tomasulo::ReservationStation &rs, int robIndex);
   void memoryAccess();
   void writeBack();
 
   void issue();
+  // false when the head of the fetch queue cannot issue, backEndStall is
+  // set when a full ROB, RS or LSQ stopped it
+  bool issueOne(bool &backEndStall);
   void commit();
+  bool commitOne(int &storePorts); // false when the ROB head cannot retire
   // Other members...
 
-  nlohmann::json simulationData; // JSON array to store cycle data
+  TraceWriter trace; // one NDJSON line per cycle
+  std::string traceFile = "simulation.ndjson";
 
   Simulator();
-  void saveCycleData(int currentCycle); // Save data for the current cycle
-  void saveSimulationData(const std::string& filename) const; // Write all data to file
+  void saveCycleData(uint64_t currentCycle); // Append the current cycle to the trace
 
-  void pipeRecover(uint32_t destPC); // record jump pc and update pc next cycle
+  void pipeRecover(uint64_t destPC, int robIndex); // record jump pc and update pc next cycle
+  uint64_t predictNextPC(FetchEntry &entry);
+  void resolveControl(int robIndex);
+  int flushAfter(int robIndex, uint64_t restartPC); // squash younger, refetch
+  void checkMemoryOrder(int storeIndex);
   // void detectDataHazard(RISCV::RegId destReg); //banned
   int64_t handleSystemCall(int64_t op1, int64_t op2);
 
@@ -0,0 +1,159 @@
+#include "StackDistance.h"
+
+#include <algorithm>
+#include <cstdio>
+
+static int log2Of(uint64_t v) {
+  int bits = 0;
+  while ((1ull << bits) < v) {
+    bits++;
+  }
+  return bits;
+}
+
+StackDistanceProfiler::StackDistanceProfiler(const std::string &name,
+                                             int lineSize, uint64_t maxSize)
+    : name(name), lineBits(log2Of(lineSize)), maxSize(maxSize),
+      tree(1 << 20, 0), fullHistogram(65, 0) {
+  // one way per set at the largest size gives the most sets
+  int maxSetBits = log2Of(maxSize) - this->lineBits;
+  for (int setBits = 1; setBits <= maxSetBits; ++setBits) {
+    SetLevel level;
+    level.setBits = setBits;
+    level.stacks.resize((size_t)MAX_WAYS << setBits);
+    level.depth.resize((size_t)1 << setBits, 0);
+    level.histogram.resize(MAX_WAYS + 1, 0);
+    this->levels.push_back(level);
+  }
+}
+
+void StackDistanceProfiler::access(uint64_t addr) {
+  uint64_t line = addr >> this->lineBits;
+  this->accesses++;
+  this->fullyAssociative(line);
+  for (SetLevel &level : this->levels) {
+    this->setAssociative(level, line);
+  }
+}
+
+void StackDistanceProfiler::treeAdd(uint64_t time, int delta) {
+  for (uint64_t i = time + 1; i <= this->tree.size(); i += i & -i) {
+    this->tree[i - 1] += delta;
+  }
+}
+
+uint64_t StackDistanceProfiler::treePrefix(uint64_t time) const {
+  uint64_t sum = 0;
+  for (uint64_t i = time; i > 0; i -= i & -i) {
+    sum += this->tree[i - 1];
+  }
+  return sum;
+}
+
+void StackDistanceProfiler::compact() {
+  std::vector<std::pair<uint64_t, uint64_t>> live; // time, line
+  live.reserve(this->lastAccess.size());
+  for (const auto &it : this->lastAccess) {
+    live.push_back({it.second, it.first});
+  }
+  std::sort(live.begin(), live.end());
+  size_t capacity = this->tree.size();
+  while (live.size() * 2 > capacity) {
+    capacity *= 2;
+  }
+  this->tree.assign(capacity, 0);
+  for (size_t t = 0; t < live.size(); ++t) {
+    this->lastAccess[live[t].second] = t;
+    this->treeAdd(t, 1);
+  }
+  this->clock = live.size();
+}
+
+void StackDistanceProfiler::fullyAssociative(uint64_t line) {
+  auto it = this->lastAccess.find(line);
+  if (it == this->lastAccess.end()) {
+    this->coldMisses++;
+  } else {
+    // distinct lines referenced since the previous reference to this one
+    uint64_t last = it->second;
+    uint64_t distance = this->treePrefix(this->clock) - this->treePrefix(last + 1);
+    this->fullHistogram[distance == 0 ? 0 : log2Of(distance + 1)]++;
+    this->treeAdd(last, -1);
+    this->lastAccess.erase(it);
+  }
+  if (this->clock == this->tree.size()) {
+    this->compact();
+  }
+  this->treeAdd(this->clock, 1);
+  this->lastAccess[line] = this->clock++;
+}
+
+void StackDistanceProfiler::setAssociative(SetLevel &level, uint64_t line) {
+  uint64_t set = line & ((1ull << level.setBits) - 1);
+  uint64_t *stack = &level.stacks[set * MAX_WAYS];
+  int depth = level.depth[set];
+  int distance = 0;
+  while (distance < depth && stack[distance] != line) {
+    distance++;
+  }
+  level.histogram[distance == depth ? MAX_WAYS : distance]++;
+  if (distance == depth) {
+    if (depth < MAX_WAYS) {
+      level.depth[set]++;
+    } else {
+      distance = MAX_WAYS - 1; // drop the deepest line
+    }
+  }
+  for (int i = distance; i > 0; --i) {
+    stack[i] = stack[i - 1];
+  }
+  stack[0] = line;
+}
+
+double StackDistanceProfiler::missRatio(uint64_t size, int ways) const {
+  if (this->accesses == 0) {
+    return 0.0;
+  }
+  int lineCountBits = log2Of(size) - this->lineBits;
+  int setBits = ways == 0 ? 0 : lineCountBits - log2Of(ways);
+  uint64_t misses = 0;
+  if (setBits == 0) {
+    // a distance of at least 2^lineCountBits misses, that is every bucket
+    // above lineCountBits
+    misses = this->coldMisses;
+    for (size_t b = lineCountBits + 1; b < this->fullHistogram.size(); ++b) {
+      misses += this->fullHistogram[b];
+    }
+  } else {
+    const SetLevel &level = this->levels[setBits - 1];
+    for (int d = ways; d <= MAX_WAYS; ++d) {
+      misses += level.histogram[d];
+    }
+  }
+  return (double)misses / this->accesses;
+}
+
+void StackDistanceProfiler::printStatistics() const {
+  const int ways[] = {1, 2, 4, 8, 16, 0};
+  printf("%s stack distance profile: %dB lines, references: %lu, cold misses: "
+         "%lu\n",
+         this->name.c_str(), 1 << this->lineBits, this->accesses,
+         this->coldMisses);
+  printf("%10s %8s %8s %8s %8s %8s %8s\n", "miss %", "1-way", "2-way",
+         "4-way", "8-way", "16-way", "full");
+  for (uint64_t size = 1024; size <= this->maxSize; size *= 2) {
+    if (size >= 1024 * 1024) {
+      printf("%8luMB ", size / (1024 * 1024));
+    } else {
+      printf("%8luKB ", size / 1024);
+    }
+    for (int w : ways) {
+      if ((uint64_t)w << this->lineBits > size) {
+        printf("%8s ", "-");
+      } else {
+        printf("%8.2f ", 100.0 * this->missRatio(size, w));
+      }
+    }
+    printf("\n");
+  }
+}
@@ -0,0 +1,65 @@
+/*
+ * Single pass LRU cache profiling
+ *
+ * Records the LRU stack distance of every reference in an address stream,
+ * from which the miss ratio of any power of two LRU cache size and
+ * associativity follows without simulating each configuration. Fully
+ * associative distances are exact and come from a Fenwick tree over the
+ * time of each line's latest reference. Set associative ones use one MRU
+ * stack per set for every power of two set count, cut at MAX_WAYS lines.
+ */
+
+#ifndef STACK_DISTANCE_H
+#define STACK_DISTANCE_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class StackDistanceProfiler {
+public:
+  static const int MAX_WAYS = 16;
+
+  StackDistanceProfiler(const std::string &name, int lineSize, uint64_t maxSize);
+
+  void access(uint64_t addr);
+
+  // Miss ratio of an LRU cache, ways = 0 for fully associative. size and
+  // ways must be powers of two, size at most maxSize.
+  double missRatio(uint64_t size, int ways) const;
+  void printStatistics() const;
+
+private:
+  // Set associative stacks of one set count
+  struct SetLevel {
+    int setBits;
+    std::vector<uint64_t> stacks;   // MAX_WAYS lines per set, MRU first
+    std::vector<uint8_t> depth;     // valid lines in each stack
+    std::vector<uint64_t> histogram; // MAX_WAYS + 1 buckets, last is deeper
+  };
+
+  void fullyAssociative(uint64_t line);
+  void setAssociative(SetLevel &level, uint64_t line);
+  // Renumbers the latest reference times to 0..n-1 once the tree is full
+  void compact();
+  void treeAdd(uint64_t time, int delta);
+  uint64_t treePrefix(uint64_t time) const; // markers at times < time
+
+  std::string name;
+  int lineBits;
+  uint64_t maxSize;
+  uint64_t accesses = 0;
+  uint64_t coldMisses = 0;
+
+  // fully associative
+  std::unordered_map<uint64_t, uint64_t> lastAccess; // line -> time
+  std::vector<uint32_t> tree; // Fenwick, 1 at the latest time of each line
+  uint64_t clock = 0;
+  // bucket 0 holds distance 0, bucket b distances in [2^(b-1), 2^b)
+  std::vector<uint64_t> fullHistogram;
+
+  std::vector<SetLevel> levels; // 2, 4, 8 ... sets
+};
+
+#endif
@@ -0,0 +1,103 @@
+#include "StoreBuffer.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "Cache.h"
+
+StoreBuffer::StoreBuffer(int size, int blockSize) : size(size) {
+  this->blockBits = 0;
+  while ((1 << this->blockBits) < blockSize) {
+    this->blockBits++;
+  }
+}
+
+const StoreBuffer::Entry *StoreBuffer::find(uint64_t block) const {
+  for (const Entry &e : this->entries) {
+    if (e.block == block) {
+      return &e;
+    }
+  }
+  return nullptr;
+}
+
+uint64_t StoreBuffer::maskOf(uint64_t block, uint64_t addr, int size) const {
+  uint64_t start = block << this->blockBits;
+  uint64_t end = start + (1ull << this->blockBits);
+  uint64_t first = std::max(addr, start);
+  uint64_t last = std::min(addr + size, end);
+  uint64_t mask = 0;
+  for (uint64_t a = first; a < last; ++a) {
+    mask |= 1ull << (a - start);
+  }
+  return mask;
+}
+
+bool StoreBuffer::canInsert(uint64_t addr, int size) const {
+  int needed = 0;
+  uint64_t last = (addr + size - 1) >> this->blockBits;
+  for (uint64_t block = addr >> this->blockBits; block <= last; ++block) {
+    if (this->find(block) == nullptr) {
+      needed++;
+    }
+  }
+  return (int)this->entries.size() + needed <= this->size;
+}
+
+void StoreBuffer::insert(uint64_t addr, int size, uint64_t pc) {
+  this->stores++;
+  uint64_t last = (addr + size - 1) >> this->blockBits;
+  for (uint64_t block = addr >> this->blockBits; block <= last; ++block) {
+    uint64_t mask = this->maskOf(block, addr, size);
+    auto it = std::find_if(this->entries.begin(), this->entries.end(),
+                           [block](const Entry &e) { return e.block == block; });
+    if (it != this->entries.end()) {
+      it->mask |= mask;
+      this->combined++;
+    } else {
+      this->entries.push_back({block, mask, pc});
+    }
+  }
+  this->maxOccupancy = std::max(this->maxOccupancy, (int)this->entries.size());
+}
+
+bool StoreBuffer::covers(uint64_t addr, int size) const {
+  uint64_t last = (addr + size - 1) >> this->blockBits;
+  for (uint64_t block = addr >> this->blockBits; block <= last; ++block) {
+    const Entry *e = this->find(block);
+    uint64_t mask = this->maskOf(block, addr, size);
+    if (e == nullptr || (e->mask & mask) != mask) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void StoreBuffer::drain(Cache *cache, uint64_t cycle) {
+  if (this->entries.empty()) {
+    return;
+  }
+  const Entry &e = this->entries.front();
+  uint64_t addr = e.block << this->blockBits;
+  if (!cache->canAccept(addr, cycle)) {
+    return;
+  }
+  cache->access(addr, true, cycle, e.pc);
+  this->entries.pop_front();
+  this->drained++;
+}
+
+void StoreBuffer::sample() {
+  this->occupancySum += this->entries.size();
+  this->cycles++;
+}
+
+void StoreBuffer::printStatistics() const {
+  printf("Store Buffer: %d entries of %dB, stores: %lu, combined: %lu, "
+         "drained: %lu, forwarded loads: %lu\n",
+         this->size, 1 << this->blockBits, this->stores, this->combined,
+         this->drained, this->forwards);
+  printf("Store Buffer: avg occupancy: %.2f, max: %d, full stalls: %lu\n",
+         this->cycles > 0 ? (double)this->occupancySum / this->cycles : 0.0,
+         this->maxOccupancy, this->fullStalls);
+}
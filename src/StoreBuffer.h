@@ -0,0 +1,62 @@
+/*
+ * Post-commit store buffer
+ *
+ * Committed stores leave the ROB into the buffer and drain to the L1D one
+ * entry per cycle, oldest first. An entry covers one aligned block, a store
+ * to a block that is still buffered is combined into its entry. Memory
+ * itself is written at commit, so the buffer only decides timing: loads
+ * whose bytes are all buffered take them from here instead of the L1D.
+ */
+
+#ifndef STORE_BUFFER_H
+#define STORE_BUFFER_H
+
+#include <cstdint>
+#include <deque>
+
+class Cache;
+
+class StoreBuffer {
+public:
+  // blockSize is at most 64 bytes, one mask bit per byte
+  StoreBuffer(int size, int blockSize);
+
+  // False when the store needs a new entry and none is free
+  bool canInsert(uint64_t addr, int size) const;
+  void insert(uint64_t addr, int size, uint64_t pc);
+  // Every byte of the access is buffered
+  bool covers(uint64_t addr, int size) const;
+  // Writes the oldest entry to cache if it takes the access this cycle
+  void drain(Cache *cache, uint64_t cycle);
+  // Called once per cycle for the occupancy statistics
+  void sample();
+
+  void printStatistics() const;
+
+  // statistics
+  uint64_t stores = 0;
+  uint64_t combined = 0;   // stores merged into an existing entry
+  uint64_t drained = 0;
+  uint64_t forwards = 0;   // loads served from the buffer
+  uint64_t fullStalls = 0; // cycles commit waited for a free entry
+  uint64_t occupancySum = 0;
+  uint64_t cycles = 0;
+  int maxOccupancy = 0;
+
+private:
+  struct Entry {
+    uint64_t block; // address / blockSize
+    uint64_t mask;  // bytes written
+    uint64_t pc;    // first store, trains the L1D prefetcher
+  };
+
+  const Entry *find(uint64_t block) const;
+  // Mask of the bytes of [addr, addr + size) inside block
+  uint64_t maskOf(uint64_t block, uint64_t addr, int size) const;
+
+  int size;
+  int blockBits;
+  std::deque<Entry> entries;
+};
+
+#endif
@@ -0,0 +1,55 @@
+#include "StoreSetPredictor.h"
+
+#include <algorithm>
+
+StoreSetPredictor::StoreSetPredictor(int ssitSize, int lfstSize)
+    : ssit(ssitSize, -1), lfst(lfstSize) {}
+
+uint32_t StoreSetPredictor::ssitIndex(uint64_t pc) const {
+  return (pc >> 2) % this->ssit.size();
+}
+
+void StoreSetPredictor::issueStore(uint64_t pc, int index, uint64_t seq) {
+  if (++this->storesSinceClear >= CLEAR_PERIOD) {
+    this->storesSinceClear = 0;
+    std::fill(this->ssit.begin(), this->ssit.end(), -1);
+    std::fill(this->lfst.begin(), this->lfst.end(), LastStore());
+  }
+  int set = this->ssit[this->ssitIndex(pc)];
+  if (set < 0) {
+    return;
+  }
+  LastStore &last = this->lfst[set];
+  last.valid = true;
+  last.index = index;
+  last.seq = seq;
+}
+
+bool StoreSetPredictor::dependence(uint64_t loadPC, int *index,
+                                   uint64_t *seq) const {
+  int set = this->ssit[this->ssitIndex(loadPC)];
+  if (set < 0 || !this->lfst[set].valid) {
+    return false;
+  }
+  // the queue checks the sequence number, a committed store no longer
+  // holds the entry
+  *index = this->lfst[set].index;
+  *seq = this->lfst[set].seq;
+  return true;
+}
+
+void StoreSetPredictor::violation(uint64_t loadPC, uint64_t storePC) {
+  int &loadSet = this->ssit[this->ssitIndex(loadPC)];
+  int &storeSet = this->ssit[this->ssitIndex(storePC)];
+  if (loadSet < 0 && storeSet < 0) {
+    loadSet = storeSet = this->nextSet;
+    this->nextSet = (this->nextSet + 1) % this->lfst.size();
+  } else if (loadSet < 0) {
+    loadSet = storeSet;
+  } else if (storeSet < 0) {
+    storeSet = loadSet;
+  } else {
+    // merge into the smaller id so both sides converge
+    loadSet = storeSet = std::min(loadSet, storeSet);
+  }
+}
@@ -0,0 +1,46 @@
+/*
+ * Store set memory dependence predictor (Chrysos and Emer)
+ *
+ * The store set id table maps load and store pcs to a store set, the last
+ * fetched store table remembers the youngest in-flight store of each set.
+ * A load only waits for that store, every other unresolved older store is
+ * speculated past. Sets are formed from the pairs of violations.
+ */
+
+#ifndef STORE_SET_PREDICTOR_H
+#define STORE_SET_PREDICTOR_H
+
+#include <cstdint>
+#include <vector>
+
+class StoreSetPredictor {
+public:
+  StoreSetPredictor(int ssitSize, int lfstSize);
+
+  // A store was issued into load/store queue entry index
+  void issueStore(uint64_t pc, int index, uint64_t seq);
+  // Returns false when the load is not predicted to depend on a store
+  bool dependence(uint64_t loadPC, int *index, uint64_t *seq) const;
+  // Puts both instructions into the same store set
+  void violation(uint64_t loadPC, uint64_t storePC);
+
+private:
+  // Long lived sets end up serializing unrelated accesses, so the table is
+  // flushed every CLEAR_PERIOD issued stores
+  static const uint32_t CLEAR_PERIOD = 1 << 16;
+
+  struct LastStore {
+    bool valid = false;
+    int index = 0;
+    uint64_t seq = 0;
+  };
+
+  uint32_t ssitIndex(uint64_t pc) const;
+
+  std::vector<int> ssit; // -1 when the pc has no store set
+  std::vector<LastStore> lfst;
+  int nextSet = 0;
+  uint32_t storesSinceClear = 0;
+};
+
+#endif
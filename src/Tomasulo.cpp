@@ -1,13 +1,18 @@
+#include <cstdint>
 #include <iostream>
 #include <string>
 #include <vector>
 #include "Tomasulo.h"
 #include "Simulator.h"
+#include "StackDistance.h"
 #include "Debug.h"
+#include "Decoder.h"
 #include "riscv.h"
 
 Tomasulo::Tomasulo(int robSize, int rsSize, int regCount) : 
-    rob(robSize), rs(rsSize), registerStatus(regCount) {}
+    rob(robSize), rs(rsSize), registerStatus(regCount),
+    checkpoints(robSize, std::vector<RegisterStatus>(regCount)),
+    hasCheckpoint(robSize, false) {}
 
 Tomasulo::~Tomasulo() {}
 
@@ -30,7 +35,7 @@ int Tomasulo::allocateRS(InstType op, int dest, int qj, int qk) {
             rs[i].vj = 0;
             rs[i].vk = 0;
             rs[i].qj = qj;
-            rs[i].qj = qk;
+            rs[i].qk = qk;
             rs[i].dest = dest;
             rs[i].busy = true;
             return i;
@@ -50,15 +55,7 @@ void Tomasulo::clearRegisterStatus(int regIndex) {
 }
 
 FunctionUnitType Tomasulo::mapInstructionToFU(RISCV::InstType type) {
-    if (isReadMem(type) || isWriteMem(type)) {
-        return FunctionUnitType::MEM;
-    }
-    
-    if (isMul(type)) {
-        return FunctionUnitType::MUL;
-    }
-    
-    return FunctionUnitType::ALU;
+    return instInfo(type).fu;
 }
 
 
@@ -79,490 +76,74 @@ void Tomasulo::commit() {
     
 }
 
-bool Tomasulo::decode(uint32_t inst, uint64_t* reg, Instruction* score_inst, Simulator* simu) {
-  std::string instname = "";
-  // std::string &inststr = op->inststr;
-  std::string inststr = "";
-  std::string deststr, op1str, op2str, offsetstr;
-  InstType instType = InstType::UNKNOWN;
-  // op constains register value
-  int64_t op1 = 0, op2 = 0, offset = 0; // op1, op2 and offset are values
-  // destReg reg1 and rs1 contain register index
-  RegId destReg = 0, reg1 = 0, reg2 = 0; // reg1 and reg2 are operands
+bool Tomasulo::isOlder(int robIndexA, int robIndexB) {
+    int size = rob.size();
+    return (robIndexA - robHead + size) % size < (robIndexB - robHead + size) % size;
+}
 
-  
-    uint32_t opcode = inst & 0x7F;
-    uint32_t funct3 = (inst >> 12) & 0x7;
-    uint32_t funct7 = (inst >> 25) & 0x7F;
-    RegId rd = (inst >> 7) & 0x1F;
-    RegId rs1 = (inst >> 15) & 0x1F;
-    RegId rs2 = (inst >> 20) & 0x1F;
-    int32_t imm_i = int32_t(inst) >> 20;
-    int32_t imm_s =
-        int32_t(((inst >> 7) & 0x1F) | ((inst >> 20) & 0xFE0)) << 20 >> 20;
-    int32_t imm_sb = int32_t(((inst >> 7) & 0x1E) | ((inst >> 20) & 0x7E0) |
-                             ((inst << 4) & 0x800) | ((inst >> 19) & 0x1000))
-                         << 19 >>
-                     19;
-    int32_t imm_u = int32_t(inst) >> 12;
-    int32_t imm_uj = int32_t(((inst >> 21) & 0x3FF) | ((inst >> 10) & 0x400) |
-                             ((inst >> 1) & 0x7F800) | ((inst >> 12) & 0x80000))
-                         << 12 >>
-                     11;
-
-    switch (opcode) {
-    case OP_REG:
-      op1 = reg[rs1];
-      op2 = reg[rs2];
-      reg1 = rs1;
-      reg2 = rs2;
-      destReg = rd;
-      switch (funct3) {
-      case 0x0: // add, mul, sub
-        if (funct7 == 0x00) {
-          instname = "add";
-          instType = ADD;
-        } else if (funct7 == 0x01) {
-          instname = "mul";
-          instType = MUL;
-        } else if (funct7 == 0x20) {
-          instname = "sub";
-          instType = SUB;
-        } else {
-          simu->panic("Unknown funct7 0x%x for funct3 0x%x\n", funct7, funct3);
-        }
-        break;
-      case 0x1: // sll, mulh
-        if (funct7 == 0x00) {
-          instname = "sll";
-          instType = SLL;
-        } else if (funct7 == 0x01) {
-          instname = "mulh";
-          instType = MULH;
-        } else {
-          simu->panic("Unknown funct7 0x%x for funct3 0x%x\n", funct7, funct3);
-        }
-        break;
-      case 0x2: // slt
-        if (funct7 == 0x00) {
-          instname = "slt";
-          instType = SLT;
-        } else {
-          simu->panic("Unknown funct7 0x%x for funct3 0x%x\n", funct7, funct3);
-        }
-        break;
-      case 0x3: // sltu
-        if (funct7 == 0x00)
-        {
-          instname = "sltu";
-          instType = SLTU;
-        }
-        else
-        {
-          simu->panic("Unknown funct7 0x%x for funct3 0x%x\n", funct7, funct3);
-        }
-        break;
-      case 0x4: // xor div
-        if (funct7 == 0x00) {
-          instname = "xor";
-          instType = XOR;
-        } else if (funct7 == 0x01) {
-          instname = "div";
-          instType = DIV;
-        } else {
-          simu->panic("Unknown funct7 0x%x for funct3 0x%x\n", funct7, funct3);
-        }
-        break;
-      case 0x5: // srl, sra
-        if (funct7 == 0x00) {
-          instname = "srl";
-          instType = SRL;
-        } else if (funct7 == 0x20) {
-          instname = "sra";
-          instType = SRA;
-        } else {
-          simu->panic("Unknown funct7 0x%x for funct3 0x%x\n", funct7, funct3);
-        }
-        break;
-      case 0x6: // or
-        if (funct7 == 0x00) {
-          instname = "or";
-          instType = OR;
-        } else {
-          simu->panic("Unknown funct7 0x%x for funct3 0x%x\n", funct7, funct3);
-        }
-        break;
-      case 0x7: // and
-        if (funct7 == 0x00) {
-          instname = "and";
-          instType = AND;
-        } else {
-          simu->panic("Unknown funct7 0x%x for funct3 0x%x\n", funct7, funct3);
-        }
-        break;
-      default:
-        simu->panic("Unknown Funct3 field %x\n", funct3);
-      }
-      op1str = REGNAME[rs1];
-      op2str = REGNAME[rs2];
-      deststr = REGNAME[rd];
-      inststr = instname + " " + deststr + "," + op1str + "," + op2str;
-      break;
-    case OP_IMM:
-      op1 = reg[rs1];
-      reg1 = rs1;
-      op2 = imm_i;
-      destReg = rd;
-      switch (funct3) {
-      case 0x0:
-        instname = "addi";
-        instType = ADDI;
-        break;
-      case 0x2:
-        instname = "slti";
-        instType = SLTI;
-        break;
-      case 0x3:
-        instname = "sltiu";
-        instType = SLTIU;
-        break;
-      case 0x4:
-        instname = "xori";
-        instType = XORI;
-        break;
-      case 0x6:
-        instname = "ori";
-        instType = ORI;
-        break;
-      case 0x7:
-        instname = "andi";
-        instType = ANDI;
-        break;
-      case 0x1:
-        instname = "slli";
-        instType = SLLI;
-        op2 = op2 & 0x3F;
-        break;
-      case 0x5:
-        if (((inst >> 26) & 0x3F) == 0x0) {
-          instname = "srli";
-          instType = SRLI;
-          op2 = op2 & 0x3F;
-        } else if (((inst >> 26) & 0x3F) == 0x10) {
-          instname = "srai";
-          instType = SRAI;
-          op2 = op2 & 0x3F;
-        } else {
-          simu->panic("Unknown funct7 0x%x for OP_IMM\n", (inst >> 26) & 0x3F);
-        }
-        break;
-      default:
-        simu->panic("Unknown Funct3 field %x\n", funct3);
-      }
-      op1str = REGNAME[rs1];
-      op2str = std::to_string(op2);
-      deststr = REGNAME[destReg];
-      inststr = instname + " " + deststr + "," + op1str + "," + op2str;
-      break;
-    case OP_LUI:
-      op1 = imm_u;
-      op2 = 0;
-      offset = imm_u;
-      destReg = rd;
-      instname = "lui";
-      instType = LUI;
-      op1str = std::to_string(imm_u);
-      deststr = REGNAME[destReg];
-      inststr = instname + " " + deststr + "," + op1str;
-      break;
-    case OP_AUIPC:
-      op1 = imm_u;
-      op2 = 0;
-      offset = imm_u;
-      destReg = rd;
-      instname = "auipc";
-      instType = AUIPC;
-      op1str = std::to_string(imm_u);
-      deststr = REGNAME[destReg];
-      inststr = instname + " " + deststr + "," + op1str;
-      break;
-    case OP_JAL:
-      op1 = imm_uj;
-      op2 = 0;
-      offset = imm_uj;
-      destReg = rd;
-      instname = "jal";
-      instType = JAL;
-      op1str = std::to_string(imm_uj);
-      deststr = REGNAME[destReg];
-      inststr = instname + " " + deststr + "," + op1str;
-      break;
-    case OP_JALR:
-      op1 = reg[rs1];
-      reg1 = rs1;
-      op2 = imm_i;
-      destReg = rd;
-      instname = "jalr";
-      instType = JALR;
-      op1str = REGNAME[rs1];
-      op2str = std::to_string(op2);
-      deststr = REGNAME[destReg];
-      inststr = instname + " " + deststr + "," + op1str + "," + op2str;
-      break;
-    case OP_BRANCH:
-      op1 = reg[rs1];
-      op2 = reg[rs2];
-      reg1 = rs1;
-      reg2 = rs2;
-      offset = imm_sb;
-      switch (funct3) {
-      case 0x0:
-        instname = "beq";
-        instType = BEQ;
-        break;
-      case 0x1:
-        instname = "bne";
-        instType = BNE;
-        break;
-      case 0x4:
-        instname = "blt";
-        instType = BLT;
-        break;
-      case 0x5:
-        instname = "bge";
-        instType = BGE;
-        break;
-      case 0x6:
-        instname = "bltu";
-        instType = BLTU;
-        break;
-      case 0x7:
-        instname = "bgeu";
-        instType = BGEU;
-        break;
-      default:
-        simu->panic("Unknown funct3 0x%x at OP_BRANCH\n", funct3);
-      }
-      op1str = REGNAME[rs1];
-      op2str = REGNAME[rs2];
-      offsetstr = std::to_string(offset);
-      inststr = instname + " " + op1str + "," + op2str + "," + offsetstr;
-      break;
-    case OP_STORE:
-      op1 = reg[rs1];
-      op2 = reg[rs2];
-      reg1 = rs1;
-      reg2 = rs2;
-      offset = imm_s;
-      switch (funct3) {
-      case 0x0:
-        instname = "sb";
-        instType = SB;
-        break;
-      case 0x1:
-        instname = "sh";
-        instType = SH;
-        break;
-      case 0x2:
-        instname = "sw";
-        instType = SW;
-        break;
-      case 0x3:
-        instname = "sd";
-        instType = SD;
-        break;
-      default:
-        simu->panic("Unknown funct3 0x%x for OP_STORE\n", funct3);
-      }
-      op1str = REGNAME[rs1];
-      op2str = REGNAME[rs2];
-      offsetstr = std::to_string(offset);
-      inststr = instname + " " + op2str + "," + offsetstr + "(" + op1str + ")";
-      break;
-    case OP_LOAD:
-      op1 = reg[rs1];
-      reg1 = rs1;
-      op2 = imm_i;
-      offset = imm_i;
-      destReg = rd;
-      switch (funct3) {
-      case 0x0:
-        instname = "lb";
-        instType = LB;
-        break;
-      case 0x1:
-        instname = "lh";
-        instType = LH;
-        break;
-      case 0x2:
-        instname = "lw";
-        instType = LW;
-        break;
-      case 0x3:
-        instname = "ld";
-        instType = LD;
-        break;
-      case 0x4:
-        instname = "lbu";
-        instType = LBU;
-        break;
-      case 0x5:
-        instname = "lhu";
-        instType = LHU;
-        break;
-      case 0x6:
-        instname = "lwu";
-        instType = LWU;
-      default:
-        simu->panic("Unknown funct3 0x%x for OP_LOAD\n", funct3);
-      }
-      op1str = REGNAME[rs1];
-      op2str = std::to_string(op2);
-      deststr = REGNAME[rd];
-      inststr = instname + " " + deststr + "," + op2str + "(" + op1str + ")";
-      break;
-    case OP_SYSTEM:
-      if (funct3 == 0x0 && funct7 == 0x000) {
-        instname = "ecall";
-        op1 = reg[REG_A0];
-        op2 = reg[REG_A7];
-        reg1 = REG_A0;
-        reg2 = REG_A7;
-        destReg = REG_A0;
-        instType = ECALL;
-      } else {
-        simu->panic("Unknown OP_SYSTEM inst with funct3 0x%x and funct7 0x%x\n",
-                    funct3, funct7);
-      }
-      inststr = instname;
-      break;
-    case OP_IMM32:
-      op1 = reg[rs1];
-      reg1 = rs1;
-      op2 = imm_i;
-      destReg = rd;
-      switch (funct3) {
-      case 0x0:
-        instname = "addiw";
-        instType = ADDIW;
-        break;
-      case 0x1:
-        instname = "slliw";
-        instType = SLLIW;
-        break;
-      case 0x5:
-        if (((inst >> 25) & 0x7F) == 0x0) {
-          instname = "srliw";
-          instType = SRLIW;
-        } else if (((inst >> 25) & 0x7F) == 0x20) {
-          instname = "sraiw";
-          instType = SRAIW;
-        } else {
-          simu->panic("Unknown shift inst type 0x%x\n", ((inst >> 25) & 0x7F));
-        }
-        break;
-      default:
-        simu->panic("Unknown funct3 0x%x for OP_ADDIW\n", funct3);
-      }
-      op1str = REGNAME[rs1];
-      op2str = std::to_string(op2);
-      deststr = REGNAME[rd];
-      inststr = instname + " " + deststr + "," + op1str + "," + op2str;
-      break;
-    case OP_32: {
-      op1 = reg[rs1];
-      op2 = reg[rs2];
-      reg1 = rs1;
-      reg2 = rs2;
-      destReg = rd;
-
-      uint32_t temp = (inst >> 25) & 0x7F; // 32bit funct7 field
-      switch (funct3) {
-      case 0x0:
-        if (temp == 0x0) {
-          instname = "addw";
-          instType = ADDW;
-        } else if (temp == 0x20) {
-          instname = "subw";
-          instType = SUBW;
-        } else {
-          simu->panic("Unknown 32bit funct7 0x%x\n", temp);
-        }
-        break;
-      case 0x1:
-        if (temp == 0x0) {
-          instname = "sllw";
-          instType = SLLW;
-        } else {
-          simu->panic("Unknown 32bit funct7 0x%x\n", temp);
-        }
-        break;
-      case 0x5:
-        if (temp == 0x0) {
-          instname = "srlw";
-          instType = SRLW;
-        } else if (temp == 0x20) {
-          instname = "sraw";
-          instType = SRAW;
-        } else {
-          simu->panic("Unknown 32bit funct7 0x%x\n", temp);
-        }
-        break;
-      default:
-        simu->panic("Unknown 32bit funct3 0x%x\n", funct3);
-      }
-      op1str = REGNAME[rs1];
-      op2str = REGNAME[rs2];
-      deststr = REGNAME[rd];
-      inststr = instname + " " + deststr + "," + op1str + "," + op2str;      
-    } break;
-    default:
-      simu->panic("Unsupported opcode 0x%x!\n", opcode);
+void Tomasulo::takeCheckpoint(int robIndex) {
+    checkpoints[robIndex] = registerStatus;
+    hasCheckpoint[robIndex] = true;
+}
+
+void Tomasulo::releaseCheckpoint(int robIndex) {
+    hasCheckpoint[robIndex] = false;
+}
+
+int Tomasulo::squashAfter(int robIndex) {
+    int size = rob.size();
+    int squashed = 0;
+
+    // Drop every ROB entry younger than robIndex
+    int current = (robIndex + 1) % size;
+    while (current != robTail) {
+        rob[current].busy = false;
+        rob[current].ready = false;
+        hasCheckpoint[current] = false;
+        squashed++;
+        current = (current + 1) % size;
+    }
+    robTail = (robIndex + 1) % size;
+    if (squashed == 0) {
+        return 0;
     }
 
-    score_inst->destReg = destReg;
-    score_inst->srcReg1 = reg1;
-    score_inst->srcReg2 = reg2;
-    score_inst->opType = instType;
-    score_inst->instStr = inststr;
-    score_inst->op.offset = offset;
-    score_inst->op.op1 = op1;
-    score_inst->op.op2 = op2;
-    FunctionUnitType unit = this->mapInstructionToFU(instType);
-
-    switch (unit) {
-    case FunctionUnitType::ALU:
-      score_inst->remainingExecCycles = 0;
-      break;
-    case FunctionUnitType::MEM:
-      score_inst->remainingExecCycles = 0;
-      break;
-    case FunctionUnitType::MUL:
-      score_inst->remainingExecCycles = 5;
-      break;
-    default:
-      break;
+    // Free the reservation stations they were waiting in
+    for (auto &station : rs) {
+        if (station.busy && !rob[station.dest].busy) {
+            station.busy = false;
+        }
     }
 
-    // funit is been occupied
-    return true;
-}
+    if (hasCheckpoint[robIndex]) {
+        // Restore the snapshot, producers that committed since have left the
+        // ROB and their values are in the register file now
+        registerStatus = checkpoints[robIndex];
+        for (auto &status : registerStatus) {
+            if (status.busy && !rob[status.robIndex].busy) {
+                status.robIndex = -1;
+                status.busy = false;
+            }
+        }
+        return squashed;
+    }
 
-bool Tomasulo::hasStoreConflict(int robIndex) {
-    int current = robHead;
-    while (current != robIndex) {
+    // No snapshot, rebuild the register status from the surviving entries
+    for (auto &status : registerStatus) {
+        status.robIndex = -1;
+        status.busy = false;
+    }
+    current = robHead;
+    do {
         const ROBEntry &entry = rob[current];
-
-        // Check if it's a Store instruction
-        if (isWriteMem(entry.inst.opType)) {
-            // Check if the Store has the same address and is ahead in the ROB
-           return true;
+        if (entry.busy && entry.destination > 0) {
+            registerStatus[entry.destination].robIndex = current;
+            registerStatus[entry.destination].busy = true;
         }
+        current = (current + 1) % size;
+    } while (current != robTail);
 
-        // Move to the next ROB entry
-        current = (current + 1) % rob.size();
-    }
-    return false; // No conflict detected
+    return squashed;
 }
 
 bool Tomasulo::execMem(Instruction* score_inst, Simulator* simu) {
@@ -643,8 +224,12 @@ bool Tomasulo::execMem(Instruction* score_inst, Simulator* simu) {
       break;
     default:break;
   }
+  score_inst->op.memLen = memLen;
+  if ((readMem || writeMem) && simu->dataProfile != nullptr) {
+    simu->dataProfile->access(out);
+  }
   
-  bool good = false;
+  bool good = readMem;
 
   if (writeMem){
     dbgprintf("m[%x] = %x\n", out, op2);
@@ -675,21 +260,21 @@ bool Tomasulo::execMem(Instruction* score_inst, Simulator* simu) {
     switch (memLen) {
     case 1:
       if (readSignExt) {
-        out = (int64_t)simu->memory->getByte(out);
+        out = (int64_t)(int8_t)simu->memory->getByte(out);
       } else {
         out = (uint64_t)simu->memory->getByte(out);
       }
       break;
     case 2:
       if (readSignExt) {
-        out = (int64_t)simu->memory->getShort(out);
+        out = (int64_t)(int16_t)simu->memory->getShort(out);
       } else {
         out = (uint64_t)simu->memory->getShort(out);
       }
       break;
     case 4:
       if (readSignExt) {
-        out = (int64_t)simu->memory->getInt(out);
+        out = (int64_t)(int32_t)simu->memory->getInt(out);
       } else {
         out = (uint64_t)simu->memory->getInt(out);
       }
@@ -704,6 +289,7 @@ bool Tomasulo::execMem(Instruction* score_inst, Simulator* simu) {
     default:
       simu->panic("Unknown memLen %d\n", memLen);
     }
+    score_inst->op.out = out;
   }
   return true;
 }
@@ -794,8 +380,26 @@ bool Tomasulo::execArthimetic(Instruction* inst, Simulator* simu) {
   case MUL:
     out = op1 * op2;
     break;
+  case MULH:
+    out = (int64_t)(((__int128)op1 * (__int128)op2) >> 64);
+    break;
   case DIV:
-    out = op1 / op2;
+    if (op2 == 0) {
+      out = -1;
+    } else if (op1 == INT64_MIN && op2 == -1) {
+      out = INT64_MIN; // overflow, the quotient wraps
+    } else {
+      out = op1 / op2;
+    }
+    break;
+  case REM:
+    if (op2 == 0) {
+      out = op1;
+    } else if (op1 == INT64_MIN && op2 == -1) {
+      out = 0;
+    } else {
+      out = op1 % op2;
+    }
     break;
   case SLTI:
   case SLT:
@@ -854,8 +458,9 @@ bool Tomasulo::execArthimetic(Instruction* inst, Simulator* simu) {
   if (branch == false) {
     jumpPC = current_pc + 4;
   }
-  if (isBranch(instType) || isJump(instType)) {
-    simu->pc = jumpPC;
+  inst->op.branch = branch;
+  inst->nextPC = jumpPC;
+  if (isControl(instType)) {
     dbgprintf("This inst JUMPs to 0x%x, offset 0x%x\n", jumpPC, inst->op.offset);
   }
   return true;
@@ -3,27 +3,35 @@
 
 #include <vector>
 #include <string>
+#include "BranchPredictor.h"
+#include "BranchTarget.h"
 #include "riscv.h"
 class Simulator;
 using namespace RISCV;
 
 // Instruction states
 enum class InstructionState { STALL, ISSUE, READ_OPERANDS, EXECUTE, WRITE_BACK, FINNISH};
-enum class FunctionUnitType { NONE, ALU, MUL, MEM};
 
 // Instruction structure
 struct Instruction {
-    int pc;            
+    uint64_t pc;            
     int destReg;       // Destination register (Fi)
     int srcReg1;       // Source register 1 (Fj)
     int srcReg2;       // Source register 2 (Fk)
     InstructionState state;  
     int remainingExecCycles = 0;  
-    RISCV::InstType opType;
+    RISCV::InstType opType = RISCV::UNKNOWN;
     uint32_t inst;
-    std::string processingUnit = "";
+    int processingUnit = -1; // unit of its FU type executing it, -1 none
+    uint32_t issueCycle = 0;
     Pipe_Op op; //TODO contains duplicate, fix it later
-    std::string instStr = "";
+    uint64_t predictedPC = 0; // pc issue continued at after this inst
+    uint64_t nextPC = 0;      // actual next pc, known after execute
+    TargetSource targetSource = TargetSource::NONE; // predictor of a jalr target
+    ReturnAddressStack::Snapshot rasState; // return stack right after fetch
+    GlobalHistory branchHistory; // speculative history before this inst
+    bool fetchWaits = false; // fetch stalled until this inst resolved
+    int lsqIndex = -1;       // load/store queue entry of a memory inst
 };
 
 class Tomasulo {
@@ -31,7 +39,7 @@ public:
     // Re-Order Buffer (ROB) entry structure
     struct ROBEntry {
         int destination;
-        int value;
+        int64_t value = 0;
         bool ready = false;   // Whether the result is ready
         bool busy = false;    // Whether the instruction is under execution
         uint64_t addr = 0;
@@ -41,7 +49,7 @@ public:
     // Reservation Station (RS) entry structure
     struct ReservationStation {
         RISCV::InstType op;        // Operation type (e.g., ADD, SUB, LOAD, STORE)
-        int vj = 0, vk = 0;   // Values for operands
+        int64_t vj = 0, vk = 0;   // Values for operands
         int qj = -1, qk = -1; // ROB entry indexes for operands, -1 if value is available
         int dest = -1;         // ROB index for result destination
         bool busy = false;     // Whether the functional unit is busy
@@ -57,8 +65,11 @@ public:
     std::vector<ROBEntry> rob;              // Re-Order Buffer
     std::vector<ReservationStation> rs;     // Reservation Stations
     std::vector<RegisterStatus> registerStatus; // Register Status Data Structure
+    // Register status snapshots taken when issue speculates past a branch,
+    // indexed by the ROB index of that branch
+    std::vector<std::vector<RegisterStatus>> checkpoints;
+    std::vector<bool> hasCheckpoint;
     int robHead = 0, robTail = 0;           // Head and tail pointers for ROB
-    int numFUs = 4;                        // Number of available functional units (e.g., 4 ALUs)
     int pc = 0;                             // Program Counter
 
     Tomasulo(int robSize, int rsSize, int regCount);
@@ -76,11 +87,12 @@ public:
     void updateRegisterStatus(int regIndex, int robIndex);
     void clearRegisterStatus(int regIndex);
     FunctionUnitType mapInstructionToFU(RISCV::InstType type);
-    std::string findAvailableFU(FunctionUnitType f_type);
     bool execArthimetic(Instruction* inst, Simulator* simu);
     bool execMem(Instruction* score_inst, Simulator* simu);
-    bool decode(uint32_t inst, uint64_t* reg, Instruction* score_inst, Simulator* simu);
-    bool hasStoreConflict(int robIndex);
+    bool isOlder(int robIndexA, int robIndexB);
+    void takeCheckpoint(int robIndex);
+    void releaseCheckpoint(int robIndex);
+    int squashAfter(int robIndex);
 
 
     // Debugging methods
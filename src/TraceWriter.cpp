@@ -0,0 +1,226 @@
+#include "TraceWriter.h"
+
+#include "Decoder.h"
+
+TraceWriter::TraceWriter() : file(nullptr) {}
+
+TraceWriter::~TraceWriter() { this->close(); }
+
+bool TraceWriter::open(const std::string &filename) {
+  this->close();
+  this->file = fopen(filename.c_str(), "w");
+  if (this->file == nullptr) {
+    fprintf(stderr, "Failed to open file: %s\n", filename.c_str());
+    return false;
+  }
+  this->filename = filename;
+  this->buffer.resize(1 << 20);
+  setvbuf(this->file, this->buffer.data(), _IOFBF, this->buffer.size());
+  this->line.reserve(64 * 1024);
+  this->lines = 0;
+  this->bytes = 0;
+  return true;
+}
+
+void TraceWriter::close() {
+  if (this->file == nullptr) {
+    return;
+  }
+  fclose(this->file);
+  this->file = nullptr;
+  printf("Simulation trace saved to %s (%lu cycles)\n", this->filename.c_str(),
+         this->lines);
+}
+
+void TraceWriter::writeCycle(uint64_t cycle, const Tomasulo &tomasulo,
+                             const uint64_t *reg, int regCount) {
+  if (this->file == nullptr) {
+    return;
+  }
+  this->line.clear();
+  this->line += '{';
+  this->appendKey("cycle");
+  this->appendUnsigned(cycle);
+
+  this->appendKey("rob");
+  this->line += '[';
+  for (size_t i = 0; i < tomasulo.rob.size(); ++i) {
+    const Tomasulo::ROBEntry &entry = tomasulo.rob[i];
+    if (i > 0) {
+      this->line += ',';
+    }
+    this->line += '{';
+    this->appendKey("destination");
+    this->appendSigned(entry.destination);
+    this->appendKey("value");
+    this->appendSigned(entry.value);
+    this->appendKey("ready");
+    this->appendBool(entry.ready);
+    this->appendKey("busy");
+    this->appendBool(entry.busy);
+    this->appendKey("addr");
+    this->appendUnsigned(entry.addr);
+    this->appendKey("inst");
+    this->appendInstruction(entry.inst);
+    this->line += '}';
+  }
+  this->line += ']';
+
+  this->appendKey("rs");
+  this->line += '[';
+  for (size_t i = 0; i < tomasulo.rs.size(); ++i) {
+    const Tomasulo::ReservationStation &rs = tomasulo.rs[i];
+    if (i > 0) {
+      this->line += ',';
+    }
+    this->line += '{';
+    this->appendKey("op");
+    this->appendSigned(static_cast<int>(rs.op));
+    this->appendKey("vj");
+    this->appendSigned(rs.vj);
+    this->appendKey("vk");
+    this->appendSigned(rs.vk);
+    this->appendKey("qj");
+    this->appendSigned(rs.qj);
+    this->appendKey("qk");
+    this->appendSigned(rs.qk);
+    this->appendKey("dest");
+    this->appendSigned(rs.dest);
+    this->appendKey("busy");
+    this->appendBool(rs.busy);
+    this->appendKey("addr");
+    this->appendUnsigned(rs.addr);
+    this->line += '}';
+  }
+  this->line += ']';
+
+  this->appendKey("registerStatus");
+  this->line += '[';
+  for (size_t i = 0; i < tomasulo.registerStatus.size(); ++i) {
+    const Tomasulo::RegisterStatus &status = tomasulo.registerStatus[i];
+    if (i > 0) {
+      this->line += ',';
+    }
+    this->line += '{';
+    this->appendKey("robIndex");
+    this->appendSigned(status.robIndex);
+    this->appendKey("busy");
+    this->appendBool(status.busy);
+    this->line += '}';
+  }
+  this->line += ']';
+
+  this->appendKey("reg");
+  this->line += '[';
+  for (int i = 0; i < regCount; ++i) {
+    if (i > 0) {
+      this->line += ',';
+    }
+    this->appendUnsigned(reg[i]);
+  }
+  this->line += "]}\n";
+
+  fwrite(this->line.data(), 1, this->line.size(), this->file);
+  this->lines++;
+  this->bytes += this->line.size();
+}
+
+// Writes "key": with the separating comma unless it opens the object
+void TraceWriter::appendKey(const char *key) {
+  if (this->line.back() != '{') {
+    this->line += ',';
+  }
+  this->line += '"';
+  this->line += key;
+  this->line += "\":";
+}
+
+void TraceWriter::appendUnsigned(uint64_t value) {
+  char digits[20];
+  int n = 0;
+  do {
+    digits[n++] = '0' + value % 10;
+    value /= 10;
+  } while (value != 0);
+  while (n > 0) {
+    this->line += digits[--n];
+  }
+}
+
+void TraceWriter::appendSigned(int64_t value) {
+  if (value < 0) {
+    this->line += '-';
+    // negate in unsigned so INT64_MIN does not overflow
+    this->appendUnsigned(~static_cast<uint64_t>(value) + 1);
+  } else {
+    this->appendUnsigned(value);
+  }
+}
+
+void TraceWriter::appendBool(bool value) {
+  this->line += value ? "true" : "false";
+}
+
+void TraceWriter::appendString(const char *value) {
+  static const char hex[] = "0123456789abcdef";
+  this->line += '"';
+  for (; *value != '\0'; ++value) {
+    char c = *value;
+    switch (c) {
+    case '"':
+      this->line += "\\\"";
+      break;
+    case '\\':
+      this->line += "\\\\";
+      break;
+    case '\n':
+      this->line += "\\n";
+      break;
+    case '\t':
+      this->line += "\\t";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        this->line += "\\u00";
+        this->line += hex[(c >> 4) & 0xf];
+        this->line += hex[c & 0xf];
+      } else {
+        this->line += c;
+      }
+    }
+  }
+  this->line += '"';
+}
+
+void TraceWriter::appendInstruction(const Instruction &inst) {
+  this->line += '{';
+  this->appendKey("pc");
+  this->appendUnsigned(inst.pc);
+  this->appendKey("destReg");
+  this->appendSigned(inst.destReg);
+  this->appendKey("srcReg1");
+  this->appendSigned(inst.srcReg1);
+  this->appendKey("srcReg2");
+  this->appendSigned(inst.srcReg2);
+  this->appendKey("state");
+  this->appendSigned(static_cast<int>(inst.state));
+  this->appendKey("remainingExecCycles");
+  this->appendSigned(inst.remainingExecCycles);
+  this->appendKey("opType");
+  this->appendSigned(static_cast<int>(inst.opType));
+  this->appendKey("inst");
+  this->appendUnsigned(inst.inst);
+  // unit names like "alu0" are only formatted here
+  char text[DISASM_MAX];
+  text[0] = '\0';
+  if (inst.processingUnit >= 0) {
+    snprintf(text, sizeof(text), "%s%d", FU_NAME[(int)instInfo(inst.opType).fu],
+             inst.processingUnit);
+  }
+  this->appendKey("processingUnit");
+  this->appendString(text);
+  this->appendKey("instStr");
+  disassemble(inst.inst, text, sizeof(text));
+  this->appendString(text);
+  this->line += '}';
+}
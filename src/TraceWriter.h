@@ -0,0 +1,50 @@
+/*
+ * Per-cycle pipeline trace
+ *
+ * Every cycle the ROB, reservation stations, register status and register
+ * file are written as one JSON object on its own line (NDJSON). Lines are
+ * formatted into a reused string and go straight to a buffered file, so
+ * memory use does not grow with the length of the run.
+ */
+
+#ifndef TRACE_WRITER_H
+#define TRACE_WRITER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "Tomasulo.h"
+
+class TraceWriter {
+public:
+  TraceWriter();
+  ~TraceWriter();
+
+  bool open(const std::string &filename);
+  // Flushes the buffered lines, safe to call when not open
+  void close();
+  bool isOpen() const { return this->file != nullptr; }
+
+  void writeCycle(uint64_t cycle, const Tomasulo &tomasulo,
+                  const uint64_t *reg, int regCount);
+
+  uint64_t lines = 0;
+  uint64_t bytes = 0;
+
+private:
+  void appendKey(const char *key);
+  void appendUnsigned(uint64_t value);
+  void appendSigned(int64_t value);
+  void appendBool(bool value);
+  void appendString(const char *value);
+  void appendInstruction(const Instruction &inst);
+
+  FILE *file;
+  std::string filename;
+  std::vector<char> buffer; // stdio buffer of file
+  std::string line;         // current cycle, keeps its capacity
+};
+
+#endif
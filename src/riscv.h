@@ -4,6 +4,10 @@
 #include <cstdarg>
 #include <cstdint>
 
+enum class FunctionUnitType : uint8_t { NONE, ALU, MUL, DIV, BRANCH, LOAD, STORE };
+const int FU_TYPE_COUNT = (int)FunctionUnitType::STORE + 1;
+extern const char *FU_NAME[FU_TYPE_COUNT];
+
 namespace RISCV {
 
 
@@ -129,95 +133,117 @@ const int OP_JALR = 0x67;
 const int OP_IMM32 = 0x1B;
 const int OP_32 = 0x3B;
 
-inline bool isBranch(InstType instType) {
-  if (instType == BEQ || instType == BNE || instType == BLT || instType == BGE ||
-      instType == BLTU || instType == BGEU) {
-    return true;
-  }
-  return false;
-}
+// Per instruction properties, so that each predicate below is a single AND
+enum InstProp : uint16_t {
+  PROP_BRANCH = 1 << 0,
+  PROP_JUMP = 1 << 1,
+  PROP_READ_MEM = 1 << 2,
+  PROP_WRITE_MEM = 1 << 3,
+  PROP_MUL = 1 << 4,
+  PROP_R_TYPE = 1 << 5,
+  PROP_I_TYPE = 1 << 6,
+  PROP_S_TYPE = 1 << 7,
+  PROP_B_TYPE = 1 << 8,
+  PROP_U_TYPE = 1 << 9,
+  PROP_J_TYPE = 1 << 10,
+};
 
-inline bool isMul(InstType instType) {
-  if (instType == MUL || instType == MULH) {
-    return true;
-  }
-  return false;
-}
-inline bool isJump(InstType instType) {
-  if (instType == JAL || instType == JALR) {
-    return true;
-  }
-  return false;
-}
+struct InstInfo {
+  uint16_t props;
+  FunctionUnitType fu;
+  uint8_t latency; // default extra execute cycles on top of the first one
+};
 
-inline bool isReadMem(InstType instType) {
-  if (instType == LB || instType == LH || instType == LW || instType == LD || instType == LBU ||
-      instType == LHU || instType == LWU) {
-    return true;
-  }
-  return false;
-}
+const int INST_TYPE_COUNT = SRAW + 1;
 
-inline bool isWriteMem(InstType instType) {
-  if (instType == SB || instType == SH || instType == SW || instType == SD) {
-    return true;
-  }
-  return false;
-}
+// Indexed by InstType + 1, slot 0 belongs to UNKNOWN
+constexpr InstInfo INST_INFO[INST_TYPE_COUNT + 1] = {
+    {0, FunctionUnitType::NONE, 0},                               // unknown
+    {PROP_U_TYPE, FunctionUnitType::ALU, 0},                      // lui
+    {PROP_U_TYPE, FunctionUnitType::ALU, 0},                      // auipc
+    {PROP_JUMP | PROP_J_TYPE, FunctionUnitType::BRANCH, 0},       // jal
+    {PROP_JUMP | PROP_I_TYPE, FunctionUnitType::BRANCH, 0},       // jalr
+    {PROP_BRANCH | PROP_B_TYPE, FunctionUnitType::BRANCH, 0},     // beq
+    {PROP_BRANCH | PROP_B_TYPE, FunctionUnitType::BRANCH, 0},     // bne
+    {PROP_BRANCH | PROP_B_TYPE, FunctionUnitType::BRANCH, 0},     // blt
+    {PROP_BRANCH | PROP_B_TYPE, FunctionUnitType::BRANCH, 0},     // bge
+    {PROP_BRANCH | PROP_B_TYPE, FunctionUnitType::BRANCH, 0},     // bltu
+    {PROP_BRANCH | PROP_B_TYPE, FunctionUnitType::BRANCH, 0},     // bgeu
+    {PROP_READ_MEM | PROP_I_TYPE, FunctionUnitType::LOAD, 0},     // lb
+    {PROP_READ_MEM | PROP_I_TYPE, FunctionUnitType::LOAD, 0},     // lh
+    {PROP_READ_MEM | PROP_I_TYPE, FunctionUnitType::LOAD, 0},     // lw
+    {PROP_READ_MEM | PROP_I_TYPE, FunctionUnitType::LOAD, 0},     // ld
+    {PROP_READ_MEM | PROP_I_TYPE, FunctionUnitType::LOAD, 0},     // lbu
+    {PROP_READ_MEM | PROP_I_TYPE, FunctionUnitType::LOAD, 0},     // lhu
+    {PROP_WRITE_MEM | PROP_S_TYPE, FunctionUnitType::STORE, 0},   // sb
+    {PROP_WRITE_MEM | PROP_S_TYPE, FunctionUnitType::STORE, 0},   // sh
+    {PROP_WRITE_MEM | PROP_S_TYPE, FunctionUnitType::STORE, 0},   // sw
+    {PROP_WRITE_MEM | PROP_S_TYPE, FunctionUnitType::STORE, 0},   // sd
+    {PROP_I_TYPE, FunctionUnitType::ALU, 0},                      // addi
+    {PROP_I_TYPE, FunctionUnitType::ALU, 0},                      // slti
+    {PROP_I_TYPE, FunctionUnitType::ALU, 0},                      // sltiu
+    {PROP_I_TYPE, FunctionUnitType::ALU, 0},                      // xori
+    {PROP_I_TYPE, FunctionUnitType::ALU, 0},                      // ori
+    {PROP_I_TYPE, FunctionUnitType::ALU, 0},                      // andi
+    {PROP_I_TYPE, FunctionUnitType::ALU, 0},                      // slli
+    {PROP_I_TYPE, FunctionUnitType::ALU, 0},                      // srli
+    {PROP_I_TYPE, FunctionUnitType::ALU, 0},                      // srai
+    {PROP_R_TYPE, FunctionUnitType::ALU, 0},                      // add
+    {PROP_R_TYPE, FunctionUnitType::ALU, 0},                      // sub
+    {PROP_R_TYPE, FunctionUnitType::ALU, 0},                      // sll
+    {PROP_R_TYPE, FunctionUnitType::ALU, 0},                      // slt
+    {PROP_R_TYPE, FunctionUnitType::ALU, 0},                      // sltu
+    {PROP_R_TYPE, FunctionUnitType::ALU, 0},                      // xor
+    {PROP_R_TYPE, FunctionUnitType::ALU, 0},                      // srl
+    {PROP_R_TYPE, FunctionUnitType::ALU, 0},                      // sra
+    {PROP_R_TYPE, FunctionUnitType::ALU, 0},                      // or
+    {PROP_R_TYPE, FunctionUnitType::ALU, 0},                      // and
+    {0, FunctionUnitType::ALU, 0},                                // ecall
+    {PROP_I_TYPE, FunctionUnitType::ALU, 0},                      // addiw
+    {PROP_MUL | PROP_R_TYPE, FunctionUnitType::MUL, 5},           // mul
+    {PROP_MUL | PROP_R_TYPE, FunctionUnitType::MUL, 5},           // mulh
+    {PROP_R_TYPE, FunctionUnitType::DIV, 19},                     // div
+    {PROP_R_TYPE, FunctionUnitType::DIV, 19},                     // rem
+    {PROP_READ_MEM | PROP_I_TYPE, FunctionUnitType::LOAD, 0},     // lwu
+    {PROP_I_TYPE, FunctionUnitType::ALU, 0},                      // slliw
+    {PROP_I_TYPE, FunctionUnitType::ALU, 0},                      // srliw
+    {PROP_I_TYPE, FunctionUnitType::ALU, 0},                      // sraiw
+    {PROP_R_TYPE, FunctionUnitType::ALU, 0},                      // addw
+    {PROP_R_TYPE, FunctionUnitType::ALU, 0},                      // subw
+    {PROP_R_TYPE, FunctionUnitType::ALU, 0},                      // sllw
+    {PROP_R_TYPE, FunctionUnitType::ALU, 0},                      // srlw
+    {PROP_R_TYPE, FunctionUnitType::ALU, 0},                      // sraw
+};
 
-inline bool isRType(InstType instType) {
-    // Check if the instruction is an R-type instruction
-    if (instType == ADD || instType == SUB || instType == SLL || instType == SLT || instType == SLTU ||
-        instType == XOR || instType == SRL || instType == SRA || instType == OR || instType == AND ||
-        instType == MUL || instType == MULH || instType == DIV || instType == REM ||
-        instType == ADDW || instType == SUBW || instType == SLLW || instType == SRLW || instType == SRAW) {
-        return true;
-    }
-    return false;
+constexpr const InstInfo &instInfo(InstType instType) {
+  return INST_INFO[instType + 1];
 }
 
-inline bool isIType(InstType instType) {
-    // Check if the instruction is an I-type instruction
-    if (instType == ADDI || instType == SLTI || instType == SLTIU || instType == XORI || instType == ORI ||
-        instType == ANDI || instType == SLLI || instType == SRLI || instType == SRAI ||
-        instType == LW || instType == LH || instType == LB || instType == LBU || instType == LHU ||
-        instType == ADDIW || instType == SLLIW || instType == SRLIW || instType == SRAIW ||
-        instType == JALR) {
-        return true;
-    }
-    return false;
-}
+static_assert(INST_INFO[LWU + 1].props == (PROP_READ_MEM | PROP_I_TYPE) &&
+                  INST_INFO[SRAW + 1].props == PROP_R_TYPE,
+              "INST_INFO is out of sync with InstType");
 
-inline bool isUType(InstType instType) {
-    if (instType == LUI || instType == AUIPC) {
-        return true;
-    }
-    return false;
+constexpr bool hasProp(InstType instType, uint16_t mask) {
+  return (instInfo(instType).props & mask) != 0;
 }
 
-inline bool isBType(InstType instType) {
-    if (instType == BEQ || instType == BNE || instType == BLT || instType == BGE ||
-        instType == BLTU || instType == BGEU) {
-        return true;
-    }
-    return false;
+inline bool isBranch(InstType instType) { return hasProp(instType, PROP_BRANCH); }
+inline bool isMul(InstType instType) { return hasProp(instType, PROP_MUL); }
+inline bool isJump(InstType instType) { return hasProp(instType, PROP_JUMP); }
+inline bool isControl(InstType instType) {
+  return hasProp(instType, PROP_BRANCH | PROP_JUMP);
 }
-
-inline bool isSType(InstType instType) {
-    if (instType == SB || instType == SH || instType == SW || instType == SD) {
-        return true;
-    }
-    return false;
+inline bool isReadMem(InstType instType) { return hasProp(instType, PROP_READ_MEM); }
+inline bool isWriteMem(InstType instType) { return hasProp(instType, PROP_WRITE_MEM); }
+inline bool isMem(InstType instType) {
+  return hasProp(instType, PROP_READ_MEM | PROP_WRITE_MEM);
 }
-
-inline bool isJType(InstType instType) {
-    if (instType == JAL) {
-        return true;
-    }
-    return false;
-}
-
-
+inline bool isRType(InstType instType) { return hasProp(instType, PROP_R_TYPE); }
+inline bool isIType(InstType instType) { return hasProp(instType, PROP_I_TYPE); }
+inline bool isUType(InstType instType) { return hasProp(instType, PROP_U_TYPE); }
+inline bool isBType(InstType instType) { return hasProp(instType, PROP_B_TYPE); }
+inline bool isSType(InstType instType) { return hasProp(instType, PROP_S_TYPE); }
+inline bool isJType(InstType instType) { return hasProp(instType, PROP_J_TYPE); }
 
 } // namespace RISCV
 